@@ -0,0 +1,82 @@
+/**
+ * @file arena.c
+ * @brief Arena allocator for records that live until the program ends.
+ *
+ * Memory is carved out of large chunks and only returned to the system
+ * when the whole arena is released, so allocating a record costs a
+ * pointer bump and releasing everything costs one free per chunk.
+ */
+
+#include "arena.h"
+
+/**
+  * @brief Alignment guaranteed for every block handed out.
+  */
+typedef union arenaAlign{
+    void *p;
+    long l;
+    double d;
+}ArenaAlign;
+
+/**
+  * @brief Allocates n bytes from the arena.
+  *
+  * @param arena Pointer to the arena.
+  * @param n Number of bytes.
+  * @return Pointer to the block, or NULL if memory is exhausted.
+  */
+void *arenaAlloc(Arena *arena, size_t n){
+    ArenaChunk *c = arena->head;
+    n = (n + sizeof(ArenaAlign) - 1) / sizeof(ArenaAlign) * sizeof(ArenaAlign);
+ 
+    if(c == NULL || c->size - c->used < n){
+        size_t size = n > ARENACHUNK ? n : ARENACHUNK;
+        c = malloc(sizeof(ArenaChunk) + size);
+        if(c == NULL){
+            return NULL;
+        }
+        c->used = 0;
+        c->size = size;
+        arena->mallocs++;
+        arena->bytes += sizeof(ArenaChunk) + size;
+        if(size > ARENACHUNK && arena->head != NULL){
+            /* Oversized blocks get their own chunk behind the current one */
+            c->next = arena->head->next;
+            arena->head->next = c;
+        }else{
+            c->next = arena->head;
+            arena->head = c;
+        }
+    }
+    c->used += n;
+    return c->data + c->used - n;
+}
+
+/**
+  * @brief Copies a string into the arena.
+  *
+  * @param arena Pointer to the arena.
+  * @param s String to copy.
+  * @return Pointer to the copy, or NULL if memory is exhausted.
+  */
+char *arenaStrdup(Arena *arena, const char *s){
+    char *copy = arenaAlloc(arena, strlen(s) + 1);
+    if(copy != NULL){
+        strcpy(copy, s);
+    }
+    return copy;
+}
+
+/**
+  * @brief Releases every block of the arena at once.
+  *
+  * @param arena Pointer to the arena.
+  */
+void freeArena(Arena *arena){
+    while(arena->head != NULL){
+        ArenaChunk *next = arena->head->next;
+        free(arena->head);
+        arena->head = next;
+    }
+    arena->bytes = 0;
+}
@@ -0,0 +1,12 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include "project.h"
+
+
+/* Function prototypes related to arena allocation */
+void *arenaAlloc(Arena *arena, size_t n);
+char *arenaStrdup(Arena *arena, const char *s);
+void freeArena(Arena *arena);
+
+#endif /* ARENA_H */
@@ -0,0 +1,159 @@
+/**
+ * @file batchindex.c
+ * @brief Hash index from batch identifier to vaccine batch.
+ *
+ * Linear probing table of batch ids. Keys are not copied: the packed
+ * identifier of a stored id is read from sys->store, and matching it is
+ * two integer compares.
+ */
+
+#include "batchindex.h"
+
+/**
+  * @brief Returns the packed identifier of a stored id.
+  *
+  * @param sys Pointer to the system.
+  * @param id Batch id.
+  * @return Pointer to the packed identifier.
+  */
+static const BatchKey *batchKey(Sys *sys, int id){
+    return &sys->store[id].key;
+}
+
+/**
+  * @brief Hashes a packed batch identifier.
+  *
+  * @param key Packed identifier.
+  * @return Hash value.
+  */
+static unsigned long hashKey(const BatchKey *key){
+    unsigned long long h = key->hi * 0x9E3779B97F4A7C15ULL ^ key->lo;
+    h ^= h >> 31;
+    h *= 0xBF58476D1CE4E5B9ULL;
+    return (unsigned long)(h ^ h >> 29);
+}
+
+/**
+  * @brief Returns the slot where a batch identifier is or should be.
+  *
+  * @param sys Pointer to the system.
+  * @param idx Table to search (with at least one free slot).
+  * @param key Packed batch identifier.
+  * @return Index of the matching or first empty slot.
+  */
+static int batchSlot(Sys *sys, BatchIndex *idx, const BatchKey *key){
+    int mask = idx->size - 1;
+    int i = (int)(hashKey(key) & (unsigned long)mask);
+    while(idx->tab[i] != -1){
+        const BatchKey *k = batchKey(sys, idx->tab[i]);
+        if(k->hi == key->hi && k->lo == key->lo){
+            break;
+        }
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+/**
+  * @brief Looks up a batch by its identifier.
+  *
+  * @param sys Pointer to the system.
+  * @param key Packed batch identifier.
+  * @return Id of the batch, or -1 if there is none.
+  */
+int findBatch(Sys *sys, const BatchKey *key){
+    int i;
+    if(sys->batches.size == 0){
+        return -1;
+    }
+    i = batchSlot(sys, &sys->batches, key);
+    return sys->batches.tab[i];
+}
+
+/**
+  * @brief Makes sure one more batch can be inserted, growing the table.
+  *
+  * @param sys Pointer to the system.
+  * @return 1 on success, 0 if memory is exhausted.
+  */
+int reserveBatchIndex(Sys *sys){
+    BatchIndex *idx = &sys->batches;
+    BatchIndex bigger;
+    int i;
+ 
+    if(2 * (idx->used + 1) <= idx->size){
+        return 1;
+    }
+    bigger.size = idx->size ? idx->size * 2 : 64;
+    bigger.used = idx->used;
+    bigger.tab = malloc(bigger.size * sizeof(int));
+    if(bigger.tab == NULL){
+        return 0;
+    }
+    for(i = 0; i < bigger.size; i++){
+        bigger.tab[i] = -1;
+    }
+    for(i = 0; i < idx->size; i++){
+        if(idx->tab[i] != -1){
+            int id = idx->tab[i];
+            bigger.tab[batchSlot(sys, &bigger, batchKey(sys, id))] = id;
+        }
+    }
+    free(idx->tab);
+    *idx = bigger;
+    return 1;
+}
+
+/**
+  * @brief Adds a batch, already present in sys->store, to the index.
+  *
+  * reserveBatchIndex() must have been called first.
+  *
+  * @param sys Pointer to the system.
+  * @param id Batch id.
+  */
+void insertBatchId(Sys *sys, int id){
+    sys->batches.tab[batchSlot(sys, &sys->batches, batchKey(sys, id))] = id;
+    sys->batches.used++;
+}
+
+/**
+  * @brief Removes a batch, still present in sys->store, from the index.
+  *
+  * Later entries of the probe run are shifted back so that lookups never
+  * need tombstones.
+  *
+  * @param sys Pointer to the system.
+  * @param id Batch id.
+  */
+void removeBatchId(Sys *sys, int id){
+    BatchIndex *idx = &sys->batches;
+    int mask = idx->size - 1;
+    int hole = batchSlot(sys, idx, batchKey(sys, id));
+    int i = hole;
+ 
+    idx->tab[hole] = -1;
+    idx->used--;
+    for(i = (i + 1) & mask; idx->tab[i] != -1; i = (i + 1) & mask){
+        int home = (int)(hashKey(batchKey(sys, idx->tab[i])) &
+            (unsigned long)mask);
+        /* Move the entry back unless its home lies in (hole, i] */
+        if((i > hole && (home <= hole || home > i)) ||
+            (i < hole && (home <= hole && home > i))){
+            idx->tab[hole] = idx->tab[i];
+            idx->tab[i] = -1;
+            hole = i;
+        }
+    }
+}
+
+/**
+  * @brief Frees all memory used by the index.
+  *
+  * @param idx Pointer to the index.
+  */
+void freeBatchIndex(BatchIndex *idx){
+    free(idx->tab);
+    idx->tab = NULL;
+    idx->size = idx->used = 0;
+}
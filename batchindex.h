@@ -0,0 +1,14 @@
+#ifndef BATCHINDEX_H
+#define BATCHINDEX_H
+
+#include "project.h"
+
+
+/* Function prototypes related to the batch identifier index */
+int findBatch(Sys *sys, const BatchKey *key);
+int reserveBatchIndex(Sys *sys);
+void insertBatchId(Sys *sys, int id);
+void removeBatchId(Sys *sys, int id);
+void freeBatchIndex(BatchIndex *idx);
+
+#endif /* BATCHINDEX_H */
@@ -0,0 +1,195 @@
+/**
+ * @file bench.c
+ * @brief Benchmark driver for the command interpreter.
+ *
+ * Runs a command file through the same reader and dispatch as the
+ * program, timing every command, and reports the overall throughput and
+ * the latency percentiles of each command. Output of the commands is
+ * formatted as usual and written to /dev/null.
+ *
+ * Usage: bench <file> [--max-batches <n>] [--pipeline] [--load <snap>]
+ *              [--journal <log>]
+ *
+ * With --load and --journal, the system is first restored as the program
+ * restores it, and the time taken by the snapshot load and by the journal
+ * replay is reported on its own. Given a snapshot and a journal of the
+ * same stream, an empty command file times both restore paths.
+ *
+ * With --pipeline, output is only written when the output buffer fills,
+ * as in the program's pipelined mode. Session-tagged streams (gen -S) are
+ * run as the program runs them, with a quitting session only ending
+ * itself, and are timed by the command after the tag.
+ */
+
+#include <time.h>
+#include "../project.h"
+#include "../system.h"
+#include "../output.h"
+#include "../input.h"
+#include "../scan.h"
+#include "../snapshot.h"
+#include "../journal.h"
+#include "../latency.h"
+
+/**
+  * @brief Latency histogram of one command.
+  */
+typedef struct hist{
+    long count;               /**< Commands timed */
+    double total;             /**< Sum of latencies in nanoseconds */
+    long max;                 /**< Largest latency in nanoseconds */
+    long bucket[LATBUCKETS];  /**< Commands per latency bucket */
+}Hist;
+
+/**
+  * @brief Returns a latency percentile, no larger than the largest
+  * latency seen.
+  *
+  * @param h Pointer to the histogram.
+  * @param p Percentile, in (0, 100].
+  * @return Latency in nanoseconds.
+  */
+static long percentile(Hist *h, double p){
+    long top = latPercentile(h->bucket, h->count, p);
+    return top < h->max ? top : h->max;
+}
+
+/**
+  * @brief Returns the time of a monotonic clock in nanoseconds.
+  *
+  * @return Time.
+  */
+static long now(void){
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000L + t.tv_nsec;
+}
+
+/**
+  * @brief Prints the report.
+  *
+  * @param hists Histogram of each command letter.
+  * @param wall Total time in nanoseconds.
+  */
+static void report(Hist *hists, long wall){
+    long n = 0;
+    int c;
+    for(c = 0; c < 26; c++){
+        n += hists[c].count;
+    }
+    printf("commands %ld  time %.3f s  throughput %.0f cmd/s\n", n,
+        wall / 1e9, wall > 0 ? n / (wall / 1e9) : 0.0);
+    printf("%-4s %10s %10s %10s %10s %10s %10s %12s\n", "cmd", "count",
+        "mean(ns)", "p50", "p90", "p99", "p99.9", "max");
+    for(c = 0; c < 26; c++){
+        Hist *h = &hists[c];
+        if(h->count == 0){
+            continue;
+        }
+        printf("%-4c %10ld %10.0f %10ld %10ld %10ld %10ld %12ld\n", 'a' + c,
+            h->count, h->total / h->count, percentile(h, 50),
+            percentile(h, 90), percentile(h, 99), percentile(h, 99.9),
+            h->max);
+    }
+}
+
+/**
+  * @brief Main function.
+  *
+  * @param argc Argument count.
+  * @param argv Argument vector.
+  * @return 0 on success, 1 on failure.
+  */
+int main(int argc, char *argv[]){
+    Hist *hists = calloc(26, sizeof(Hist));
+    Sys *sys = newSys();
+    Input input;
+    const char *snap = NULL, *log = NULL;
+    char *buf;
+    long start;
+    int i, pipelined = 0;
+
+    if(argc < 2 || hists == NULL || sys == NULL){
+        fprintf(stderr,
+            "usage: bench <file> [--max-batches <n>] [--pipeline] "
+            "[--load <snap>] [--journal <log>]\n");
+        return 1;
+    }
+    sys->maxV = 1 << 30;
+    for(i = 2; i < argc; i++){
+        if(strcmp(argv[i], "--max-batches") == 0 && i + 1 < argc){
+            sys->maxV = atoi(argv[++i]);
+        }else if(strcmp(argv[i], "--pipeline") == 0){
+            pipelined = 1;
+        }else if(strcmp(argv[i], "--load") == 0 && i + 1 < argc){
+            snap = argv[++i];
+        }else if(strcmp(argv[i], "--journal") == 0 && i + 1 < argc){
+            log = argv[++i];
+        }
+    }
+    if(snap != NULL){
+        start = now();
+        if(!loadSnapshot(sys, snap)){
+            fprintf(stderr, "%s: invalid snapshot\n", snap);
+            freeSys(sys);
+            free(hists);
+            return 1;
+        }
+        printf("load %s  time %.3f s\n", snap, (now() - start) / 1e9);
+    }
+    if(log != NULL){
+        start = now();
+        if(!openJournal(sys, log, 1)){
+            fprintf(stderr, "%s: invalid journal\n", log);
+            freeSys(sys);
+            free(hists);
+            return 1;
+        }
+        printf("replay %s  time %.3f s\n", log, (now() - start) / 1e9);
+    }
+    sys->out.fp = fopen("/dev/null", "w");
+#ifdef STATS
+    sys->stats.clock = now;
+#endif
+    if(!openInput(&input, argv[1], 1)){
+        perror(argv[1]);
+        return 1;
+    }
+
+    start = now();
+    while((buf = nextLine(&input)) != NULL){
+        long t0 = now(), ns;
+        int c;
+        if((buf = sessionLine(sys, buf)) == NULL){
+            continue;
+        }
+        c = buf[0] - 'a';
+        if(buf[0] == 'q'){
+            break;
+        }
+        runCommand(sys, buf);
+        stepScans(sys);
+        if(!pipelined){
+            outFlush(&sys->out);
+        }
+        ns = now() - t0;
+        if(c >= 0 && c < 26){
+            Hist *h = &hists[c];
+            h->bucket[latBucket(ns)]++;
+            h->count++;
+            h->total += ns;
+            h->max = ns > h->max ? ns : h->max;
+        }
+    }
+    finishScans(sys, NULL, 0);
+    outFlush(&sys->out);
+    report(hists, now() - start);
+
+    closeInput(&input);
+    if(sys->out.fp != NULL){
+        fclose(sys->out.fp);
+    }
+    freeSys(sys);
+    free(hists);
+    return 0;
+}
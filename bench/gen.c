@@ -0,0 +1,314 @@
+/**
+ * @file gen.c
+ * @brief Seeded generator of command streams for benchmarking.
+ *
+ * Writes a stream of commands to standard output: first a prologue that
+ * creates the requested number of batches, then a mix of c/a/u/d/l/r/t
+ * commands in the requested proportions. The same seed always produces
+ * the same stream. With -S, every command is tagged with one of that many
+ * sessions, as a front end multiplexing many terminals would send them.
+ * -F sets how many 'u' and 'l' commands in a thousand are full listings.
+ *
+ * Usage: gen [-s seed] [-n commands] [-b batches] [-v vaccines]
+ *            [-u users] [-q quoted%] [-m c,a,u,d,l,r,t] [-S sessions]
+ *            [-F full-per-mille]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NCMDS 7                 /**< Number of command kinds in the mix */
+
+/**
+  * @brief Settings and state of the generator.
+  */
+typedef struct gen{
+    unsigned long long seed;  /**< State of the random number generator */
+    long cmds;                /**< Commands to generate after the prologue */
+    long batches;             /**< Batches created by the prologue */
+    int vaccines;             /**< Number of distinct vaccine names */
+    long users;               /**< Number of distinct user names */
+    int quoted;               /**< Percentage of quoted user names */
+    long sessions;            /**< Number of sessions, or 0 for none */
+    int full;                 /**< Full listings per thousand 'u' and 'l' */
+    int mix[NCMDS];           /**< Weight of each command in "caudlrt" */
+    long created;             /**< Batches created so far */
+    int day, month, year;     /**< Current date of the stream */
+}Gen;
+
+/**
+  * @brief Returns the next pseudo-random number (xorshift64*).
+  *
+  * @param g Pointer to the generator.
+  * @return Random number.
+  */
+static unsigned long long next(Gen *g){
+    g->seed ^= g->seed >> 12;
+    g->seed ^= g->seed << 25;
+    g->seed ^= g->seed >> 27;
+    return g->seed * 2685821657736338717ULL;
+}
+
+/**
+  * @brief Returns a random number in [0, n).
+  *
+  * @param g Pointer to the generator.
+  * @param n Upper bound (positive).
+  * @return Random number.
+  */
+static long pick(Gen *g, long n){
+    return (long)(next(g) % (unsigned long long)n);
+}
+
+/**
+  * @brief Returns a user, favouring a small set of frequent users.
+  *
+  * Half of the picks come from the first tenth of the users, which makes
+  * per-user histories uneven, as they are in practice.
+  *
+  * @param g Pointer to the generator.
+  * @return User number.
+  */
+static long pickUser(Gen *g){
+    long hot = g->users / 10 > 0 ? g->users / 10 : 1;
+    return pick(g, 2) ? pick(g, hot) : pick(g, g->users);
+}
+
+/**
+  * @brief Prints a user name, quoted for some users.
+  *
+  * @param g Pointer to the generator.
+  * @param u User number.
+  */
+static void printUser(Gen *g, long u){
+    if(u % 100 < g->quoted){
+        printf("\"user %ld\"", u);
+    }else{
+        printf("user%ld", u);
+    }
+}
+
+/**
+  * @brief Prints the tag of a random session, if there are sessions.
+  *
+  * @param g Pointer to the generator.
+  */
+static void printSession(Gen *g){
+    if(g->sessions > 0){
+        printf("@t%ld ", pick(g, g->sessions));
+    }
+}
+
+/**
+  * @brief Returns the number of days in a month.
+  *
+  * @param month Month.
+  * @param year Year.
+  * @return Number of days.
+  */
+static int monthDays(int month, int year){
+    static const int days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    int leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+    return days[month - 1] + (month == 2 && leap);
+}
+
+/**
+  * @brief Prints the date some days after the current date.
+  *
+  * @param g Pointer to the generator.
+  * @param ahead Number of days.
+  */
+static void printDateAhead(Gen *g, long ahead){
+    int d = g->day, m = g->month, y = g->year;
+    while(ahead-- > 0){
+        if(++d > monthDays(m, y)){
+            d = 1;
+            if(++m > 12){
+                m = 1;
+                y++;
+            }
+        }
+    }
+    printf("%d-%d-%d", d, m, y);
+}
+
+/**
+  * @brief Prints the identifier of the i-th batch of the stream.
+  *
+  * Multiplying by an odd constant is a bijection, so identifiers are
+  * distinct, and it spreads them over the whole hexadecimal range.
+  *
+  * @param i Batch number.
+  */
+static void printBatchId(unsigned long long i){
+    printf("%llX", (i + 1) * 0x9E3779B97F4A7C15ULL);
+}
+
+/**
+  * @brief Prints a 'c' command for a new batch.
+  *
+  * New batches expire one month to two years after the current date.
+  *
+  * @param g Pointer to the generator.
+  */
+static void genCreate(Gen *g){
+    printf("c ");
+    printBatchId((unsigned long long)g->created++);
+    printf(" ");
+    printDateAhead(g, 30 + pick(g, 700));
+    printf(" %ld vacc%ld\n", 1 + pick(g, 500), pick(g, g->vaccines));
+}
+
+/**
+  * @brief Prints the identifier of a random batch created so far.
+  *
+  * @param g Pointer to the generator.
+  */
+static void printSomeBatch(Gen *g){
+    printBatchId((unsigned long long)(g->created ? pick(g, g->created) : 0));
+}
+
+/**
+  * @brief Prints one command of the given kind.
+  *
+  * @param g Pointer to the generator.
+  * @param kind Index of the command in "caudlrt".
+  */
+static void genCommand(Gen *g, int kind){
+    switch(kind){
+        case 0:
+            genCreate(g);
+            break;
+        case 1:
+            printf("a ");
+            printUser(g, pickUser(g));
+            printf(" vacc%ld\n", pick(g, g->vaccines));
+            break;
+        case 2:
+            /* Full dumps are rare by default; most are for one user */
+            if(pick(g, 1000) < g->full){
+                printf("u\n");
+            }else{
+                printf("u ");
+                printUser(g, pickUser(g));
+                printf("\n");
+            }
+            break;
+        case 3:
+            printf("d ");
+            printUser(g, pickUser(g));
+            if(pick(g, 2)){
+                printf(" %d-%d-%d", g->day, g->month, g->year);
+                if(pick(g, 2)){
+                    printf(" ");
+                    printSomeBatch(g);
+                }
+            }
+            printf("\n");
+            break;
+        case 4:
+            if(pick(g, 1000) < g->full){
+                printf("l\n");
+            }else{
+                printf("l vacc%ld vacc%ld\n", pick(g, g->vaccines),
+                    pick(g, g->vaccines));
+            }
+            break;
+        case 5:
+            printf("r ");
+            printSomeBatch(g);
+            printf("\n");
+            break;
+        case 6:
+            printf("t ");
+            printDateAhead(g, 1);
+            printf("\n");
+            if(++g->day > monthDays(g->month, g->year)){
+                g->day = 1;
+                if(++g->month > 12){
+                    g->month = 1;
+                    g->year++;
+                }
+            }
+            break;
+    }
+}
+
+/**
+  * @brief Reads the command mix from a comma-separated list of weights.
+  *
+  * @param g Pointer to the generator.
+  * @param s Weights of c, a, u, d, l, r and t, in that order.
+  * @return 1 if the mix is valid, 0 otherwise.
+  */
+static int parseMix(Gen *g, char *s){
+    int i, total = 0;
+    for(i = 0; i < NCMDS; i++){
+        char *end;
+        g->mix[i] = (int)strtol(s, &end, 10);
+        if(end == s || g->mix[i] < 0 || (*end != ',' && i < NCMDS - 1)){
+            return 0;
+        }
+        total += g->mix[i];
+        s = end + 1;
+    }
+    return total > 0;
+}
+
+/**
+  * @brief Main function.
+  *
+  * @param argc Argument count.
+  * @param argv Argument vector.
+  * @return 0 on success, 1 on a bad argument.
+  */
+int main(int argc, char *argv[]){
+    Gen g = {88172645463325252ULL, 100000, 1000, 50, 100000, 10, 0, 1,
+        {20, 700, 100, 30, 50, 10, 1}, 0, 1, 1, 2025};
+    long i;
+    int total = 0, k;
+
+    for(k = 1; k + 1 < argc; k += 2){
+        char *v = argv[k + 1];
+        if(strcmp(argv[k], "-s") == 0){
+            g.seed = strtoull(v, NULL, 10) * 2 + 1;
+        }else if(strcmp(argv[k], "-n") == 0){
+            g.cmds = atol(v);
+        }else if(strcmp(argv[k], "-b") == 0){
+            g.batches = atol(v);
+        }else if(strcmp(argv[k], "-v") == 0){
+            g.vaccines = atoi(v) > 0 ? atoi(v) : 1;
+        }else if(strcmp(argv[k], "-u") == 0){
+            g.users = atol(v) > 0 ? atol(v) : 1;
+        }else if(strcmp(argv[k], "-q") == 0){
+            g.quoted = atoi(v);
+        }else if(strcmp(argv[k], "-S") == 0){
+            g.sessions = atol(v);
+        }else if(strcmp(argv[k], "-F") == 0){
+            g.full = atoi(v);
+        }else if(strcmp(argv[k], "-m") == 0 && parseMix(&g, v)){
+            continue;
+        }else{
+            fprintf(stderr, "gen: bad argument %s\n", argv[k]);
+            return 1;
+        }
+    }
+
+    for(k = 0; k < NCMDS; k++){
+        total += g.mix[k];
+    }
+    for(i = 0; i < g.batches; i++){
+        printSession(&g);
+        genCreate(&g);
+    }
+    for(i = 0; i < g.cmds; i++){
+        int r = (int)pick(&g, total);
+        for(k = 0; r >= g.mix[k]; k++){
+            r -= g.mix[k];
+        }
+        printSession(&g);
+        genCommand(&g, k);
+    }
+    return 0;
+}
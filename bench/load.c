@@ -0,0 +1,306 @@
+/**
+ * @file load.c
+ * @brief Load client for the network front end.
+ *
+ * Connects once to create the batches, then opens many connections to
+ * bench/server and keeps one command in flight on each: as soon as a
+ * connection's reply arrives, it sends its next command, until the
+ * requested number of commands has been answered. Commands are mostly
+ * 'a' of random users and vaccines, with some 's' and 't'; each of them
+ * prints exactly one line, so every line read is one reply. Reports the
+ * aggregate throughput and the percentiles of the time from sending a
+ * command to reading its reply.
+ *
+ * Usage: load <socket-path | port> [-c connections] [-n commands]
+ *             [-b batches] [-s seed]
+ */
+
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "../project.h"
+#include "../latency.h"
+
+#define MAXEVENTS 256           /**< Events handled per epoll_wait */
+#define NAMES 10                /**< Distinct vaccine names */
+#define USERS 100000            /**< Distinct user names */
+
+/**
+  * @brief Connection with one command in flight.
+  */
+typedef struct conn{
+    int fd;                   /**< Socket */
+    long sent;                /**< When the command in flight was sent */
+    unsigned long long seed;  /**< State of its random number generator */
+    char in[256];             /**< Start of a reply not yet complete */
+    int len;                  /**< Bytes in in */
+}Conn;
+
+/**
+  * @brief Returns the time of a monotonic clock in nanoseconds.
+  *
+  * @return Time.
+  */
+static long now(void){
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000L + t.tv_nsec;
+}
+
+/**
+  * @brief Returns the next pseudo-random number of a generator.
+  *
+  * @param seed Pointer to the state of the generator.
+  * @return Number.
+  */
+static unsigned long next(unsigned long long *seed){
+    *seed = *seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (unsigned long)(*seed >> 33);
+}
+
+/**
+  * @brief Connects to the front end.
+  *
+  * @param where Path of a Unix socket, or a TCP port on the loopback
+  *              interface if it is all digits.
+  * @return The socket, or -1 on error.
+  */
+static int connectTo(const char *where){
+    int fd;
+    if(where[strspn(where, "0123456789")] == '\0'){
+        struct sockaddr_in a;
+        memset(&a, 0, sizeof(a));
+        a.sin_family = AF_INET;
+        a.sin_port = htons((unsigned short)atoi(where));
+        a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if(fd < 0 || connect(fd, (struct sockaddr *)&a, sizeof(a)) < 0){
+            return -1;
+        }
+    }else{
+        struct sockaddr_un a;
+        memset(&a, 0, sizeof(a));
+        a.sun_family = AF_UNIX;
+        strncpy(a.sun_path, where, sizeof(a.sun_path) - 1);
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if(fd < 0 || connect(fd, (struct sockaddr *)&a, sizeof(a)) < 0){
+            return -1;
+        }
+    }
+    return fd;
+}
+
+/**
+  * @brief Writes a whole string.
+  *
+  * @param fd Socket.
+  * @param s String.
+  * @return 1 on success, 0 on error.
+  */
+static int sendAll(int fd, const char *s){
+    size_t len = strlen(s);
+    while(len > 0){
+        ssize_t n = write(fd, s, len);
+        if(n < 0 && errno == EINTR){
+            continue;
+        }
+        if(n <= 0){
+            return 0;
+        }
+        s += n;
+        len -= (size_t)n;
+    }
+    return 1;
+}
+
+/**
+  * @brief Creates the batches on a connection of its own and waits for
+  * every reply.
+  *
+  * @param where Where the front end listens.
+  * @param batches Number of batches.
+  * @param doses Doses of each batch.
+  * @return 1 on success, 0 on error.
+  */
+static int setup(const char *where, long batches, long doses){
+    char line[128], buf[4096];
+    long i, replies = 0;
+    int fd = connectTo(where);
+    if(fd < 0){
+        return 0;
+    }
+    for(i = 0; i < batches; i++){
+        sprintf(line, "c %lX 01-01-2099 %ld v%ld\n", i + 1, doses,
+            i % NAMES);
+        if(!sendAll(fd, line)){
+            close(fd);
+            return 0;
+        }
+    }
+    while(replies < batches){
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if(n <= 0){
+            close(fd);
+            return 0;
+        }
+        for(i = 0; i < n; i++){
+            replies += buf[i] == '\n';
+        }
+    }
+    close(fd);
+    return 1;
+}
+
+/**
+  * @brief Sends a connection's next command.
+  *
+  * @param c Pointer to the connection.
+  * @return 1 on success, 0 on error.
+  */
+static int sendCommand(Conn *c){
+    char line[128];
+    unsigned long r = next(&c->seed);
+    if(r % 20 == 0){
+        strcpy(line, "s\n");
+    }else if(r % 20 == 1){
+        strcpy(line, "t\n");
+    }else{
+        sprintf(line, "a user%lu v%lu\n", (r >> 5) % USERS,
+            (r >> 3) % NAMES);
+    }
+    c->sent = now();
+    return sendAll(c->fd, line);
+}
+
+/**
+  * @brief Returns a latency percentile, no larger than the largest
+  * latency seen.
+  *
+  * @param bucket Commands per latency bucket.
+  * @param count Commands timed.
+  * @param max Largest latency in nanoseconds.
+  * @param p Percentile, in (0, 100].
+  * @return Latency in nanoseconds.
+  */
+static long percentile(const long *bucket, long count, long max, double p){
+    long top = latPercentile(bucket, count, p);
+    return top < max ? top : max;
+}
+
+/**
+  * @brief Main function.
+  *
+  * @param argc Argument count.
+  * @param argv Argument vector.
+  * @return 0 on success, 1 on error.
+  */
+int main(int argc, char *argv[]){
+    long conns = 200, total = 100000, batches = 100, seed = 1;
+    long sent = 0, done = 0, start, wall, max = 0;
+    long *bucket = calloc(LATBUCKETS, sizeof(long));
+    struct epoll_event events[MAXEVENTS];
+    Conn *c;
+    int ep, i;
+
+    if(argc < 2 || bucket == NULL){
+        fprintf(stderr, "Usage: load <socket-path | port> "
+            "[-c connections] [-n commands] [-b batches] [-s seed]\n");
+        return 1;
+    }
+    for(i = 2; i + 1 < argc; i += 2){
+        if(strcmp(argv[i], "-c") == 0){
+            conns = atol(argv[i + 1]);
+        }else if(strcmp(argv[i], "-n") == 0){
+            total = atol(argv[i + 1]);
+        }else if(strcmp(argv[i], "-b") == 0){
+            batches = atol(argv[i + 1]);
+        }else if(strcmp(argv[i], "-s") == 0){
+            seed = atol(argv[i + 1]);
+        }
+    }
+    conns = conns < 1 ? 1 : conns > total ? total : conns;
+    if(!setup(argv[1], batches, total / batches * 2 + 100)){
+        perror("load: setup");
+        return 1;
+    }
+    if((c = calloc(conns, sizeof(Conn))) == NULL ||
+        (ep = epoll_create1(0)) < 0){
+        perror("load");
+        return 1;
+    }
+    for(i = 0; i < conns; i++){
+        struct epoll_event ev;
+        if((c[i].fd = connectTo(argv[1])) < 0){
+            perror("load: connect");
+            return 1;
+        }
+        c[i].seed = (unsigned long long)seed * 1000003 + i;
+        ev.events = EPOLLIN;
+        ev.data.ptr = &c[i];
+        epoll_ctl(ep, EPOLL_CTL_ADD, c[i].fd, &ev);
+    }
+
+    start = now();
+    for(i = 0; i < conns; i++, sent++){
+        if(!sendCommand(&c[i])){
+            perror("load: send");
+            return 1;
+        }
+    }
+    while(done < total){
+        int n = epoll_wait(ep, events, MAXEVENTS, -1);
+        int k;
+        if(n < 0 && errno != EINTR){
+            perror("epoll_wait");
+            return 1;
+        }
+        for(k = 0; k < n; k++){
+            Conn *cn = events[k].data.ptr;
+            ssize_t got = read(cn->fd, cn->in + cn->len,
+                sizeof(cn->in) - cn->len);
+            char *nl;
+            if(got <= 0){
+                fprintf(stderr, "load: connection closed\n");
+                return 1;
+            }
+            cn->len += (int)got;
+            /* One command in flight, so at most one reply is waiting */
+            if((nl = memchr(cn->in, '\n', cn->len)) != NULL){
+                long lat = now() - cn->sent;
+                bucket[latBucket(lat)]++;
+                max = lat > max ? lat : max;
+                done++;
+                cn->len = 0;
+                if(sent < total){
+                    if(!sendCommand(cn)){
+                        perror("load: send");
+                        return 1;
+                    }
+                    sent++;
+                }
+            }else if(cn->len == (int)sizeof(cn->in)){
+                cn->len = 0;
+            }
+        }
+    }
+    wall = now() - start;
+
+    printf("connections %ld  commands %ld  time %.3f s  throughput %.0f "
+        "cmd/s\n", conns, done, wall / 1e9, done / (wall / 1e9));
+    printf("%10s %10s %10s %10s %12s\n", "p50(ns)", "p90", "p99", "p99.9",
+        "max");
+    printf("%10ld %10ld %10ld %10ld %12ld\n",
+        percentile(bucket, done, max, 50), percentile(bucket, done, max, 90),
+        percentile(bucket, done, max, 99),
+        percentile(bucket, done, max, 99.9), max);
+    for(i = 0; i < conns; i++){
+        close(c[i].fd);
+    }
+    free(c);
+    free(bucket);
+    return 0;
+}
@@ -0,0 +1,242 @@
+/**
+ * @file parse.c
+ * @brief Microbenchmark of command parsing.
+ *
+ * Reads a command file, groups its lines by command, and times parsing
+ * each group on its own: every line is tokenized as its command's
+ * handler tokenizes it, with the same sequence of nextToken, nextName,
+ * parseDate, parseInt and parseBatch calls, but nothing is looked up or
+ * run. The tokenizer works in place, so each pass parses a fresh copy of
+ * the lines; the copy is not timed. Reports the best of five passes in
+ * nanoseconds per line. Session tags (gen -S) are skipped before the
+ * command, as the program skips them.
+ *
+ * Usage: parse <file>
+ */
+
+#include <time.h>
+#include "../project.h"
+#include "../parser.h"
+#include "../input.h"
+
+#define PASSES 5                /**< Passes over each group; best is kept */
+#define CMDS "caubdlrts"        /**< Commands timed, in report order */
+
+/**
+  * @brief Lines of one command, stored back to back.
+  */
+typedef struct group{
+    char *text;               /**< Lines, each null-terminated */
+    char *work;               /**< Copy of the lines parsed by a pass */
+    long size;                /**< Bytes used in text */
+    long cap;                 /**< Bytes allocated for text */
+    long lines;               /**< Number of lines */
+}Group;
+
+/**
+  * @brief Returns the time of a monotonic clock in nanoseconds.
+  *
+  * @return Time.
+  */
+static long now(void){
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000L + t.tv_nsec;
+}
+
+/**
+  * @brief Appends a line to a group.
+  *
+  * @param g Pointer to the group.
+  * @param line Line, without its newline.
+  * @param len Length of the line.
+  * @return 1 on success, 0 if memory is exhausted.
+  */
+static int addLine(Group *g, const char *line, long len){
+    if(g->size + len + 1 > g->cap){
+        long cap = g->cap ? g->cap * 2 : 4096;
+        char *p;
+        while(cap < g->size + len + 1){
+            cap *= 2;
+        }
+        if((p = realloc(g->text, cap)) == NULL){
+            return 0;
+        }
+        g->text = p;
+        g->cap = cap;
+    }
+    memcpy(g->text + g->size, line, len);
+    g->text[g->size + len] = '\0';
+    g->size += len + 1;
+    g->lines++;
+    return 1;
+}
+
+/**
+  * @brief Parses one command line as its handler does.
+  *
+  * @param line Command line, without a session tag.
+  * @return Sum of values read, so the parsing is not optimized away.
+  */
+static long parseLine(char *line){
+    Token a = {"", 0}, b = {"", 0}, c = {"", 0}, d = {"", 0};
+    char *cur = line + 1;
+    long sum = 0;
+    Date date;
+    BatchKey key;
+    int n;
+
+    switch(line[0]){
+        case 'c':
+            nextToken(&cur, &a);
+            nextToken(&cur, &b);
+            nextToken(&cur, &c);
+            nextToken(&cur, &d);
+            sum += parseDate(&b, &date) ? date.day : 0;
+            sum += parseInt(&c, &n) ? n : 0;
+            sum += parseBatch(&a, &key) + d.len;
+            break;
+        case 'a':
+            nextName(&cur, &a);
+            nextToken(&cur, &b);
+            sum += a.len + b.len;
+            break;
+        case 'b':
+            nextToken(&cur, &a);
+            while(nextName(&cur, &b) > 0){
+                sum += b.len;
+            }
+            break;
+        case 'u':
+            while(isspace((unsigned char)*cur)){
+                cur++;
+            }
+            if(nextName(&cur, &a) > 0 && nextToken(&cur, &b)){
+                if(!nextToken(&cur, &c)){
+                    c = b;
+                    b = a;
+                }
+                sum += parseDate(&b, &date) ? date.day : 0;
+                sum += parseDate(&c, &date) ? date.day : 0;
+            }
+            sum += a.len;
+            break;
+        case 'd':
+            if(nextName(&cur, &a) >= 0){
+                if(nextToken(&cur, &b)){
+                    sum += parseDate(&b, &date) ? date.day : 0;
+                }
+                if(nextToken(&cur, &c)){
+                    sum += parseBatch(&c, &key);
+                }
+            }
+            sum += a.len;
+            break;
+        case 'l':
+        case 'r':
+        case 's':
+            while(nextToken(&cur, &a)){
+                sum += a.len;
+            }
+            break;
+        case 't':
+            if(nextToken(&cur, &a)){
+                sum += parseDate(&a, &date) ? date.day : 0;
+            }
+            break;
+    }
+    return sum;
+}
+
+/**
+  * @brief Parses every line of a group once.
+  *
+  * @param g Pointer to the group; its work copy must be fresh.
+  * @return Sum of values read.
+  */
+static long parseGroup(Group *g){
+    char *line = g->work, *end = g->work + g->size;
+    long sum = 0;
+    while(line < end){
+        char *next = line + strlen(line) + 1;
+        sum += parseLine(line);
+        line = next;
+    }
+    return sum;
+}
+
+/**
+  * @brief Main function.
+  *
+  * @param argc Argument count.
+  * @param argv Argument vector.
+  * @return 0 on success, 1 on error.
+  */
+int main(int argc, char *argv[]){
+    Group groups[sizeof(CMDS) - 1] = {{0}};
+    Input input;
+    char *line;
+    long totalLines = 0, totalTime = 0, sink = 0;
+    int i, k;
+
+    if(argc != 2){
+        fprintf(stderr, "Usage: parse <file>\n");
+        return 1;
+    }
+    if(!openInput(&input, argv[1], 1)){
+        fprintf(stderr, "parse: cannot read %s\n", argv[1]);
+        return 1;
+    }
+    while((line = nextLine(&input)) != NULL){
+        char *cmd = line, *pos;
+        if(*cmd == '@'){
+            while(*cmd != '\0' && !isspace((unsigned char)*cmd)){
+                cmd++;
+            }
+            while(isspace((unsigned char)*cmd)){
+                cmd++;
+            }
+        }
+        if(*cmd == '\0' || (pos = strchr(CMDS, *cmd)) == NULL){
+            continue;
+        }
+        if(!addLine(&groups[pos - CMDS], cmd, (long)strlen(cmd))){
+            fprintf(stderr, "parse: out of memory\n");
+            return 1;
+        }
+    }
+    closeInput(&input);
+
+    printf("%-4s %10s %10s %12s\n", "cmd", "lines", "ns/line",
+        "M lines/s");
+    for(i = 0; CMDS[i] != '\0'; i++){
+        Group *g = &groups[i];
+        long best = 0;
+        if(g->lines == 0){
+            continue;
+        }
+        if((g->work = malloc(g->size)) == NULL){
+            fprintf(stderr, "parse: out of memory\n");
+            return 1;
+        }
+        for(k = 0; k < PASSES; k++){
+            long t;
+            memcpy(g->work, g->text, g->size);
+            t = now();
+            sink += parseGroup(g);
+            t = now() - t;
+            best = k == 0 || t < best ? t : best;
+        }
+        printf("%-4c %10ld %10.1f %12.1f\n", CMDS[i], g->lines,
+            (double)best / g->lines, g->lines / (best / 1e3));
+        totalLines += g->lines;
+        totalTime += best;
+        free(g->work);
+        free(g->text);
+    }
+    if(totalLines > 0){
+        printf("%-4s %10ld %10.1f %12.1f\n", "all", totalLines,
+            (double)totalTime / totalLines, totalLines / (totalTime / 1e3));
+    }
+    return sink == -1;
+}
@@ -0,0 +1,317 @@
+/**
+ * @file scan.c
+ * @brief Benchmark of history scans: the column store against the list.
+ *
+ * Builds the same inoculation records twice: in the History column store
+ * the program uses, and in the linked list of InocNode records it used
+ * before, allocated node by node with the user name after each node as
+ * the list did. Nodes allocated back to back sit closer together than in
+ * a long run of the program, so the list times are a lower bound. Then
+ * times two scans of each, and reports the best of three runs in
+ * nanoseconds per record:
+ *
+ * - dump: every live record is visited and its user, batch and date read,
+ *   as 'u' without arguments does before formatting;
+ * - filter: the records of one user on one date are counted, as 'd'
+ *   with a date does.
+ *
+ * Usage: scan [records...]   (default 1000000 10000000)
+ */
+
+#include <time.h>
+#include "../project.h"
+#include "../history.h"
+#include "../utils.h"
+
+#define USERS 100000            /**< Distinct users of the records */
+#define PERDAY 2000             /**< Records made on each day */
+#define RUNS 3                  /**< Runs of each scan; the best is kept */
+
+/**
+  * @brief Inoculation record as the list stored it.
+  */
+typedef struct oldInoc{
+    char *userName;           /**< Name of the user (allocated) */
+    char batch[MAXSIZEBATCH]; /**< Batch identifier used */
+    char vType[MAXNAMEVACC];  /**< Name of the vaccine applied */
+    Date aplication;          /**< Date of inoculation */
+}OldInoc;
+
+/**
+  * @brief Node of the list of inoculations.
+  */
+typedef struct oldNode{
+    OldInoc inoc;             /**< Inoculation record */
+    struct oldNode *next;     /**< Next node */
+}OldNode;
+
+/**
+  * @brief Returns the time of a monotonic clock in nanoseconds.
+  *
+  * @return Time.
+  */
+static long now(void){
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000L + t.tv_nsec;
+}
+
+/**
+  * @brief Returns the user of a record, favouring a tenth of the users.
+  *
+  * @param i Index of the record.
+  * @return User number.
+  */
+static int userOf(long i){
+    unsigned long h = (unsigned long)i * 2654435761UL;
+    return (int)(h % 2 ? (h >> 8) % (USERS / 10) : (h >> 8) % USERS);
+}
+
+/**
+  * @brief Returns the date of a record.
+  *
+  * @param i Index of the record.
+  * @return Date.
+  */
+static Date dateOf(long i){
+    return unpackDate(packDate((Date){1, 1, 2025}) + (int)(i / PERDAY));
+}
+
+/**
+  * @brief Builds the list of n records.
+  *
+  * @param n Number of records.
+  * @return Head of the list, or NULL if memory is exhausted.
+  */
+static OldNode *buildList(long n){
+    OldNode *head = NULL, *tail = NULL;
+    long i;
+    for(i = 0; i < n; i++){
+        OldNode *node = malloc(sizeof(OldNode));
+        char name[32];
+        if(node == NULL){
+            return NULL;
+        }
+        sprintf(name, "user%d", userOf(i));
+        node->inoc.userName = malloc(strlen(name) + 1);
+        if(node->inoc.userName == NULL){
+            return NULL;
+        }
+        strcpy(node->inoc.userName, name);
+        sprintf(node->inoc.batch, "%lX", (unsigned long)(i % 1000) + 1);
+        sprintf(node->inoc.vType, "vacc%ld", i % 50);
+        node->inoc.aplication = dateOf(i);
+        node->next = NULL;
+        if(tail == NULL){
+            head = node;
+        }else{
+            tail->next = node;
+        }
+        tail = node;
+    }
+    return head;
+}
+
+/**
+  * @brief Frees the list.
+  *
+  * @param head Head of the list.
+  */
+static void freeList(OldNode *head){
+    while(head != NULL){
+        OldNode *next = head->next;
+        free(head->inoc.userName);
+        free(head);
+        head = next;
+    }
+}
+
+/**
+  * @brief Builds the column store of n records.
+  *
+  * @param h Pointer to an empty history.
+  * @param n Number of records.
+  * @return 1 on success, 0 if memory is exhausted.
+  */
+static int buildColumns(History *h, long n){
+    long i;
+    if(!reserveHistory(h, (int)n)){
+        return 0;
+    }
+    for(i = 0; i < n; i++){
+        appendHistory(h, userOf(i), (int)(i % 1000), (int)(i % 50),
+            packDate(dateOf(i)));
+    }
+    return 1;
+}
+
+/**
+  * @brief Visits every record of the list.
+  *
+  * @param head Head of the list.
+  * @return Sum of the fields read, so the scan is not optimized away.
+  */
+static long dumpList(OldNode *head){
+    long sum = 0;
+    for(; head != NULL; head = head->next){
+        sum += head->inoc.userName[0] + head->inoc.batch[0] +
+            head->inoc.aplication.day + head->inoc.aplication.month +
+            head->inoc.aplication.year;
+    }
+    return sum;
+}
+
+/**
+  * @brief Visits every live record of the column store.
+  *
+  * @param h Pointer to the history.
+  * @return Sum of the fields read, so the scan is not optimized away.
+  */
+static long dumpColumns(History *h){
+    long sum = 0;
+    int i;
+    for(i = 0; i < h->cnt; i++){
+        if(isLive(h, i)){
+            sum += h->user[i] + h->batch[i] + h->date[i];
+        }
+    }
+    return sum;
+}
+
+/**
+  * @brief Counts the records of the list of one user on one date.
+  *
+  * @param head Head of the list.
+  * @param user Name of the user.
+  * @param date Date.
+  * @return Number of records.
+  */
+static long filterList(OldNode *head, const char *user, Date date){
+    long cnt = 0;
+    for(; head != NULL; head = head->next){
+        if(strcmp(head->inoc.userName, user) == 0 &&
+            compareDates(head->inoc.aplication, date) == 0){
+            cnt++;
+        }
+    }
+    return cnt;
+}
+
+/**
+  * @brief Counts the live records of the column store of one user on one
+  * date.
+  *
+  * @param h Pointer to the history.
+  * @param user User id.
+  * @param date Packed date.
+  * @return Number of records.
+  */
+static long filterColumns(History *h, int user, int date){
+    long cnt = 0;
+    int i;
+    for(i = 0; i < h->cnt; i++){
+        if(h->user[i] == user && h->date[i] == date && isLive(h, i)){
+            cnt++;
+        }
+    }
+    return cnt;
+}
+
+/**
+  * @brief Prints the best time of a scan per record.
+  *
+  * @param what Name of the scan.
+  * @param best Best time in nanoseconds.
+  * @param n Number of records.
+  * @param result Result of the scan.
+  */
+static void report(const char *what, long best, long n, long result){
+    printf("%-16s %8.2f ns/record %10.1f M records/s  (%ld)\n", what,
+        (double)best / n, n / (best / 1e3), result);
+}
+
+/**
+  * @brief Builds n records both ways and times the scans.
+  *
+  * @param n Number of records.
+  * @return 1 on success, 0 if memory is exhausted.
+  */
+static int run(long n){
+    History h = {0};
+    OldNode *list;
+    long t, best[4] = {0, 0, 0, 0}, res[4] = {0, 0, 0, 0};
+    int r, k;
+    int user = userOf(n / 2);
+    Date day = dateOf(n / 2);
+    char name[32];
+
+    sprintf(name, "user%d", user);
+    t = now();
+    list = buildList(n);
+    if(list == NULL){
+        return 0;
+    }
+    printf("== %ld records: list built in %.2f s", n, (now() - t) / 1e9);
+    t = now();
+    if(!buildColumns(&h, n)){
+        freeList(list);
+        return 0;
+    }
+    printf(", columns in %.2f s\n", (now() - t) / 1e9);
+
+    for(r = 0; r < RUNS; r++){
+        for(k = 0; k < 4; k++){
+            t = now();
+            switch(k){
+                case 0:
+                    res[k] = dumpList(list);
+                    break;
+                case 1:
+                    res[k] = dumpColumns(&h);
+                    break;
+                case 2:
+                    res[k] = filterList(list, name, day);
+                    break;
+                case 3:
+                    res[k] = filterColumns(&h, user, packDate(day));
+                    break;
+            }
+            t = now() - t;
+            best[k] = r == 0 || t < best[k] ? t : best[k];
+        }
+    }
+    report("dump list", best[0], n, res[0]);
+    report("dump columns", best[1], n, res[1]);
+    report("filter list", best[2], n, res[2]);
+    report("filter columns", best[3], n, res[3]);
+    freeList(list);
+    freeHistory(&h);
+    return 1;
+}
+
+/**
+  * @brief Main function.
+  *
+  * @param argc Argument count.
+  * @param argv Argument vector.
+  * @return 0 on success, 1 if memory is exhausted.
+  */
+int main(int argc, char *argv[]){
+    long sizes[] = {1000000, 10000000};
+    int i;
+    if(argc < 2){
+        for(i = 0; i < 2; i++){
+            if(!run(sizes[i])){
+                fprintf(stderr, "scan: out of memory\n");
+                return 1;
+            }
+        }
+    }
+    for(i = 1; i < argc; i++){
+        if(!run(atol(argv[i]))){
+            fprintf(stderr, "scan: out of memory\n");
+            return 1;
+        }
+    }
+    return 0;
+}
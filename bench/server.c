@@ -0,0 +1,491 @@
+/**
+ * @file server.c
+ * @brief Network front end that shares one running program among many
+ * clients.
+ *
+ * Starts the program with its standard input and output on pipes, and
+ * accepts clients on a Unix socket or on a TCP port of the loopback
+ * interface. Every line a client sends is passed on tagged with that
+ * client's session, "@<fd>.<n> <line>", where n counts the clients
+ * accepted, so a tag is never reused even when a descriptor is; every
+ * line the program writes with a tag goes back, without the tag, to the
+ * client still holding it, and untagged lines go to standard output. A
+ * client that disconnects ends its session with "@<tag> q".
+ *
+ * One epoll loop serves the listening socket, the clients and both pipes,
+ * all nonblocking: what cannot be written yet waits in that descriptor's
+ * buffer until epoll reports it writable, so neither the program nor a
+ * slow client can stall the others. Buffers grow as needed. When the
+ * program goes quiet after writing, an empty line lets it print the next
+ * chunk of any pending long listing, until a step prints nothing.
+ *
+ * Usage: server <socket-path | port> [program [args...]]
+ *        (the program defaults to ./proj)
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include "../project.h"
+
+#define MAXEVENTS 64            /**< Events handled per epoll_wait */
+#define READSIZE 65536          /**< Bytes read at a time */
+#define IDLEMS 1                /**< Quiet time before stepping listings */
+
+/**
+  * @brief Growable byte buffer.
+  */
+typedef struct buffer{
+    char *data;               /**< Bytes */
+    size_t len;               /**< Bytes held */
+    size_t cap;               /**< Bytes allocated */
+}Buffer;
+
+/**
+  * @brief Connected client.
+  */
+typedef struct client{
+    int fd;                   /**< Socket */
+    long id;                  /**< Number of the client, never reused */
+    char tag[32];             /**< Session tag, "@<fd>.<id>" */
+    Buffer in;                /**< Received bytes not yet forming a line */
+    Buffer out;               /**< Replies not yet written */
+}Client;
+
+/**
+  * @brief State of the front end.
+  */
+typedef struct server{
+    int ep;                   /**< Epoll instance */
+    int listener;             /**< Listening socket */
+    int toProg;               /**< Program's standard input */
+    int fromProg;             /**< Program's standard output */
+    Buffer progIn;            /**< Lines not yet written to the program */
+    Buffer progOut;           /**< Output of the program not yet a line */
+    Client **clients;         /**< Clients by descriptor, or NULL */
+    int cntClients;           /**< Size of clients */
+    long nextId;              /**< Number of the next client */
+    int quiet;                /**< Nothing written since the last step */
+}Server;
+
+/**
+  * @brief Appends bytes to a buffer.
+  *
+  * @param b Pointer to the buffer.
+  * @param data Bytes.
+  * @param len Number of bytes.
+  * @return 1 on success, 0 if memory is exhausted.
+  */
+static int append(Buffer *b, const char *data, size_t len){
+    if(len == 0){
+        return 1;
+    }
+    if(b->len + len > b->cap){
+        size_t cap = b->cap ? b->cap * 2 : 4096;
+        char *p;
+        while(cap < b->len + len){
+            cap *= 2;
+        }
+        if((p = realloc(b->data, cap)) == NULL){
+            return 0;
+        }
+        b->data = p;
+        b->cap = cap;
+    }
+    memcpy(b->data + b->len, data, len);
+    b->len += len;
+    return 1;
+}
+
+/**
+  * @brief Drops bytes from the front of a buffer.
+  *
+  * @param b Pointer to the buffer.
+  * @param n Number of bytes.
+  */
+static void consume(Buffer *b, size_t n){
+    memmove(b->data, b->data + n, b->len - n);
+    b->len -= n;
+}
+
+/**
+  * @brief Sets which events epoll reports for a descriptor.
+  *
+  * @param s Pointer to the server.
+  * @param fd Descriptor.
+  * @param events Events.
+  * @param add 1 to add the descriptor, 0 to change it.
+  */
+static void watch(Server *s, int fd, unsigned events, int add){
+    struct epoll_event ev;
+    ev.events = events;
+    ev.data.fd = fd;
+    epoll_ctl(s->ep, add ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, fd, &ev);
+}
+
+/**
+  * @brief Writes as much of a buffer as the descriptor takes now.
+  *
+  * @param fd Nonblocking descriptor.
+  * @param b Pointer to the buffer.
+  * @return 1 if the buffer was emptied, 0 if bytes remain, -1 on error.
+  */
+static int drain(int fd, Buffer *b){
+    while(b->len > 0){
+        ssize_t n = write(fd, b->data, b->len);
+        if(n < 0 && errno == EINTR){
+            continue;
+        }
+        if(n < 0){
+            return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+        }
+        consume(b, (size_t)n);
+    }
+    return 1;
+}
+
+/**
+  * @brief Writes what is pending for the program, and asks epoll to
+  * report its input writable while anything remains.
+  *
+  * @param s Pointer to the server.
+  * @return 1 on success, 0 if the program cannot be written to.
+  */
+static int flushProg(Server *s){
+    int r = drain(s->toProg, &s->progIn);
+    if(r >= 0){
+        watch(s, s->toProg, r ? 0 : EPOLLOUT, 0);
+    }
+    return r >= 0;
+}
+
+/**
+  * @brief Closes a client, ending its session.
+  *
+  * Replies still on their way to it are dropped when they arrive, since
+  * no other client will ever hold its tag.
+  *
+  * @param s Pointer to the server.
+  * @param c Pointer to the client.
+  */
+static void closeClient(Server *s, Client *c){
+    if(c->in.len > 0){
+        append(&s->progIn, c->tag, strlen(c->tag));
+        append(&s->progIn, " ", 1);
+        append(&s->progIn, c->in.data, c->in.len);
+        append(&s->progIn, "\n", 1);
+    }
+    append(&s->progIn, c->tag, strlen(c->tag));
+    append(&s->progIn, " q\n", 3);
+    epoll_ctl(s->ep, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    s->clients[c->fd] = NULL;
+    free(c->in.data);
+    free(c->out.data);
+    free(c);
+}
+
+/**
+  * @brief Accepts every pending client.
+  *
+  * @param s Pointer to the server.
+  */
+static void acceptClients(Server *s){
+    int fd;
+    while((fd = accept(s->listener, NULL, NULL)) >= 0){
+        Client *c = calloc(1, sizeof(Client));
+        if(fd >= s->cntClients){
+            int cnt = s->cntClients ? s->cntClients : 64;
+            Client **p;
+            while(cnt <= fd){
+                cnt *= 2;
+            }
+            p = realloc(s->clients, cnt * sizeof(Client *));
+            if(p == NULL){
+                free(c);
+                close(fd);
+                continue;
+            }
+            memset(p + s->cntClients, 0,
+                (cnt - s->cntClients) * sizeof(Client *));
+            s->clients = p;
+            s->cntClients = cnt;
+        }
+        if(c == NULL){
+            close(fd);
+            continue;
+        }
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+        c->fd = fd;
+        c->id = s->nextId++;
+        sprintf(c->tag, "@%d.%ld", fd, c->id);
+        s->clients[fd] = c;
+        watch(s, fd, EPOLLIN, 1);
+    }
+}
+
+/**
+  * @brief Reads from a client and passes its complete lines on, tagged.
+  *
+  * @param s Pointer to the server.
+  * @param c Pointer to the client.
+  */
+static void readClient(Server *s, Client *c){
+    char buf[READSIZE];
+    ssize_t n = read(c->fd, buf, sizeof(buf));
+    size_t start = 0, i;
+    if(n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)){
+        closeClient(s, c);
+        return;
+    }
+    if(n < 0){
+        return;
+    }
+    for(i = 0; i < (size_t)n; i++){
+        if(buf[i] == '\n'){
+            append(&s->progIn, c->tag, strlen(c->tag));
+            append(&s->progIn, " ", 1);
+            append(&s->progIn, c->in.data, c->in.len);
+            append(&s->progIn, buf + start, i + 1 - start);
+            c->in.len = 0;
+            start = i + 1;
+        }
+    }
+    append(&c->in, buf + start, (size_t)n - start);
+}
+
+/**
+  * @brief Writes what is pending for a client, and asks epoll to report
+  * it writable while anything remains.
+  *
+  * @param s Pointer to the server.
+  * @param c Pointer to the client.
+  */
+static void flushClient(Server *s, Client *c){
+    int r = drain(c->fd, &c->out);
+    if(r < 0){
+        closeClient(s, c);
+    }else{
+        watch(s, c->fd, r ? EPOLLIN : EPOLLIN | EPOLLOUT, 0);
+    }
+}
+
+/**
+  * @brief Routes one line of the program's output.
+  *
+  * @param s Pointer to the server.
+  * @param line Line, with its newline.
+  * @param len Length of the line.
+  */
+static void routeLine(Server *s, char *line, size_t len){
+    char *end = line, *rest;
+    int fd;
+    long id;
+    if(line[0] != '@'){
+        fwrite(line, 1, len, stdout);
+        return;
+    }
+    while(end < line + len && *end != ' ' && *end != '\n'){
+        end++;
+    }
+    rest = end < line + len && *end == ' ' ? end + 1 : end;
+    if(sscanf(line, "@%d.%ld", &fd, &id) != 2 || fd < 0 ||
+        fd >= s->cntClients || s->clients[fd] == NULL ||
+        s->clients[fd]->id != id){
+        return;
+    }
+    append(&s->clients[fd]->out, rest, (size_t)(line + len - rest));
+}
+
+/**
+  * @brief Reads the program's output and routes its complete lines.
+  *
+  * @param s Pointer to the server.
+  * @return 1 while the program runs, 0 once its output is closed.
+  */
+static int readProg(Server *s){
+    char buf[READSIZE];
+    ssize_t n = read(s->fromProg, buf, sizeof(buf));
+    size_t start = 0, i;
+    int fd;
+    if(n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)){
+        return 0;
+    }
+    if(n < 0 || !append(&s->progOut, buf, (size_t)n)){
+        return 1;
+    }
+    for(i = 0; i < s->progOut.len; i++){
+        if(s->progOut.data[i] == '\n'){
+            routeLine(s, s->progOut.data + start, i + 1 - start);
+            start = i + 1;
+        }
+    }
+    consume(&s->progOut, start);
+    fflush(stdout);
+    for(fd = 0; fd < s->cntClients; fd++){
+        if(s->clients[fd] != NULL && s->clients[fd]->out.len > 0){
+            flushClient(s, s->clients[fd]);
+        }
+    }
+    s->quiet = 0;
+    return 1;
+}
+
+/**
+  * @brief Opens the listening socket.
+  *
+  * @param where Path of a Unix socket, or a TCP port on the loopback
+  *              interface if it is all digits.
+  * @return The socket, or -1 on error.
+  */
+static int listenOn(const char *where){
+    int fd, one = 1;
+    if(where[strspn(where, "0123456789")] == '\0'){
+        struct sockaddr_in a;
+        memset(&a, 0, sizeof(a));
+        a.sin_family = AF_INET;
+        a.sin_port = htons((unsigned short)atoi(where));
+        a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if(fd < 0 || setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one,
+            sizeof(one)) < 0 || bind(fd, (struct sockaddr *)&a,
+            sizeof(a)) < 0){
+            return -1;
+        }
+    }else{
+        struct sockaddr_un a;
+        memset(&a, 0, sizeof(a));
+        a.sun_family = AF_UNIX;
+        if(strlen(where) >= sizeof(a.sun_path)){
+            return -1;
+        }
+        strcpy(a.sun_path, where);
+        unlink(where);
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if(fd < 0 || bind(fd, (struct sockaddr *)&a, sizeof(a)) < 0){
+            return -1;
+        }
+    }
+    if(listen(fd, SOMAXCONN) < 0){
+        return -1;
+    }
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    return fd;
+}
+
+/**
+  * @brief Starts the program with its standard input and output on
+  * pipes.
+  *
+  * @param s Pointer to the server; its pipe ends are set.
+  * @param argv Program and its arguments.
+  * @return Process id, or -1 on error.
+  */
+static pid_t startProg(Server *s, char *argv[]){
+    int in[2], out[2];
+    pid_t pid;
+    if(pipe(in) < 0 || pipe(out) < 0 || (pid = fork()) < 0){
+        return -1;
+    }
+    if(pid == 0){
+        dup2(in[0], 0);
+        dup2(out[1], 1);
+        close(in[0]);
+        close(in[1]);
+        close(out[0]);
+        close(out[1]);
+        execvp(argv[0], argv);
+        perror(argv[0]);
+        _exit(127);
+    }
+    close(in[0]);
+    close(out[1]);
+    s->toProg = in[1];
+    s->fromProg = out[0];
+    fcntl(s->toProg, F_SETFL, O_NONBLOCK);
+    fcntl(s->fromProg, F_SETFL, O_NONBLOCK);
+    return pid;
+}
+
+/**
+  * @brief Main function.
+  *
+  * Runs until the program exits, which it does once its standard input
+  * is closed; interrupting the server closes it.
+  *
+  * @param argc Argument count.
+  * @param argv Argument vector.
+  * @return 0 on success, 1 on error.
+  */
+int main(int argc, char *argv[]){
+    Server s;
+    struct epoll_event events[MAXEVENTS];
+    char *prog[] = {"./proj", NULL};
+    int running = 1, status = 0;
+    pid_t pid;
+
+    if(argc < 2){
+        fprintf(stderr,
+            "Usage: server <socket-path | port> [program [args...]]\n");
+        return 1;
+    }
+    memset(&s, 0, sizeof(s));
+    signal(SIGPIPE, SIG_IGN);
+    if((s.listener = listenOn(argv[1])) < 0){
+        perror(argv[1]);
+        return 1;
+    }
+    if((pid = startProg(&s, argc > 2 ? argv + 2 : prog)) < 0 ||
+        (s.ep = epoll_create1(0)) < 0){
+        perror("server");
+        return 1;
+    }
+    watch(&s, s.listener, EPOLLIN, 1);
+    watch(&s, s.fromProg, EPOLLIN, 1);
+    watch(&s, s.toProg, 0, 1);
+    s.quiet = 1;
+
+    while(running){
+        int n = epoll_wait(s.ep, events, MAXEVENTS,
+            s.quiet || s.progIn.len > 0 ? -1 : IDLEMS);
+        int i;
+        if(n < 0 && errno != EINTR){
+            perror("epoll_wait");
+            break;
+        }
+        if(n == 0){
+            /* An empty line runs nothing but steps pending listings */
+            append(&s.progIn, "\n", 1);
+            s.quiet = 1;
+        }
+        for(i = 0; i < n; i++){
+            int fd = events[i].data.fd;
+            if(fd == s.listener){
+                acceptClients(&s);
+            }else if(fd == s.fromProg){
+                running = readProg(&s);
+            }else if(fd != s.toProg && fd < s.cntClients &&
+                s.clients[fd] != NULL){
+                if(events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)){
+                    readClient(&s, s.clients[fd]);
+                }
+                if(s.clients[fd] != NULL &&
+                    (events[i].events & EPOLLOUT)){
+                    flushClient(&s, s.clients[fd]);
+                }
+            }
+        }
+        if(running && s.progIn.len > 0 && !flushProg(&s)){
+            running = 0;
+        }
+    }
+    close(s.toProg);
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
@@ -0,0 +1,171 @@
+/**
+ * @file dayset.c
+ * @brief Set of the (user, vaccine) pairs inoculated on the current date.
+ *
+ * The set only holds indices of inoculation records of the current date,
+ * so its size is bounded by the number of applications of one day. It is
+ * emptied whenever the simulated date moves forward.
+ */
+
+#include "dayset.h"
+
+/**
+  * @brief Hashes a (user, vaccine) pair.
+  *
+  * @param user User id.
+  * @param vacc Vaccine name id.
+  * @return Hash value.
+  */
+static unsigned long pairHash(int user, int vacc){
+    unsigned long h = (unsigned long)user * 2654435761UL + (unsigned long)vacc;
+    return h ^ (h >> 15);
+}
+
+/**
+  * @brief Returns the slot where a pair is or should be stored.
+  *
+  * @param set Pointer to the set (with at least one free slot).
+  * @param h Pointer to the inoculation records.
+  * @param user User id.
+  * @param vacc Vaccine name id.
+  * @return Index of the matching or first empty slot.
+  */
+static int pairSlot(DaySet *set, History *h, int user, int vacc){
+    int mask = set->size - 1;
+    int i = (int)(pairHash(user, vacc) & (unsigned long)mask);
+    while(set->tab[i] != -1 && (h->user[set->tab[i]] != user ||
+        h->vType[set->tab[i]] != vacc)){
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+/**
+  * @brief Looks up today's inoculation of a user with a vaccine.
+  *
+  * @param set Pointer to the set.
+  * @param h Pointer to the inoculation records.
+  * @param user User id.
+  * @param vacc Vaccine name id.
+  * @return Index of the record, or -1 if there is none today.
+  */
+int findToday(DaySet *set, History *h, int user, int vacc){
+    if(set->used == 0){
+        return -1;
+    }
+    return set->tab[pairSlot(set, h, user, vacc)];
+}
+
+/**
+  * @brief Makes sure n more pairs can be inserted, growing the table.
+  *
+  * @param set Pointer to the set.
+  * @param h Pointer to the inoculation records.
+  * @param n Number of pairs.
+  * @return 1 on success, 0 if memory is exhausted.
+  */
+int reserveDaySet(DaySet *set, History *h, int n){
+    DaySet bigger;
+    int i;
+ 
+    if(2 * (set->used + n) <= set->size){
+        return 1;
+    }
+    bigger.size = set->size ? set->size * 2 : 64;
+    while(bigger.size < 2 * (set->used + n)){
+        bigger.size *= 2;
+    }
+    bigger.used = set->used;
+    bigger.tab = malloc(bigger.size * sizeof(int));
+    if(bigger.tab == NULL){
+        return 0;
+    }
+    for(i = 0; i < bigger.size; i++){
+        bigger.tab[i] = -1;
+    }
+    for(i = 0; i < set->size; i++){
+        int r = set->tab[i];
+        if(r != -1){
+            bigger.tab[pairSlot(&bigger, h, h->user[r], h->vType[r])] = r;
+        }
+    }
+    free(set->tab);
+    *set = bigger;
+    return 1;
+}
+
+/**
+  * @brief Adds a record of the current date to the set.
+  *
+  * reserveDaySet() must have been called first.
+  *
+  * @param set Pointer to the set.
+  * @param h Pointer to the inoculation records.
+  * @param r Index of the record.
+  */
+void addToday(DaySet *set, History *h, int r){
+    set->tab[pairSlot(set, h, h->user[r], h->vType[r])] = r;
+    set->used++;
+}
+
+/**
+  * @brief Removes a record from the set, if present.
+  *
+  * Later entries of the probe run are shifted back so that lookups never
+  * need tombstones.
+  *
+  * @param set Pointer to the set.
+  * @param h Pointer to the inoculation records.
+  * @param r Index of the record.
+  */
+void removeToday(DaySet *set, History *h, int r){
+    int mask = set->size - 1;
+    int hole, i;
+ 
+    if(set->used == 0){
+        return;
+    }
+    hole = pairSlot(set, h, h->user[r], h->vType[r]);
+    if(set->tab[hole] != r){
+        return;
+    }
+    set->tab[hole] = -1;
+    set->used--;
+    for(i = (hole + 1) & mask; set->tab[i] != -1; i = (i + 1) & mask){
+        int home = (int)(pairHash(h->user[set->tab[i]],
+            h->vType[set->tab[i]]) & (unsigned long)mask);
+        /* Move the entry back unless its home lies in (hole, i] */
+        if((i > hole && (home <= hole || home > i)) ||
+            (i < hole && (home <= hole && home > i))){
+            set->tab[hole] = set->tab[i];
+            set->tab[i] = -1;
+            hole = i;
+        }
+    }
+}
+
+/**
+  * @brief Empties the set, keeping its table for the next date.
+  *
+  * @param set Pointer to the set.
+  */
+void clearDaySet(DaySet *set){
+    int i;
+    if(set->used > 0){
+        for(i = 0; i < set->size; i++){
+            set->tab[i] = -1;
+        }
+        set->used = 0;
+    }
+}
+
+/**
+  * @brief Frees all memory used by the set.
+  *
+  * @param set Pointer to the set.
+  */
+void freeDaySet(DaySet *set){
+    free(set->tab);
+    set->tab = NULL;
+    set->size = set->used = 0;
+}
@@ -0,0 +1,15 @@
+#ifndef DAYSET_H
+#define DAYSET_H
+
+#include "project.h"
+
+
+/* Function prototypes related to the set of today's inoculations */
+int findToday(DaySet *set, History *h, int user, int vacc);
+int reserveDaySet(DaySet *set, History *h, int n);
+void addToday(DaySet *set, History *h, int r);
+void removeToday(DaySet *set, History *h, int r);
+void clearDaySet(DaySet *set);
+void freeDaySet(DaySet *set);
+
+#endif /* DAYSET_H */
@@ -0,0 +1,177 @@
+/**
+ * @file history.c
+ * @brief Column store of inoculation records.
+ *
+ * Each field lives in its own contiguous array, so listing or filtering
+ * the history walks memory sequentially instead of chasing pointers.
+ */
+
+#include "history.h"
+
+/**
+  * @brief Makes sure n more records can be appended.
+  *
+  * All columns grow together; if one of them cannot grow, the ones that
+  * already did simply keep their larger allocation.
+  *
+  * @param h Pointer to the history.
+  * @param n Number of records.
+  * @return 1 on success, 0 if memory is exhausted.
+  */
+int reserveHistory(History *h, int n){
+    int newCap;
+    void *p;
+    if(h->cnt + n <= h->cap){
+        return 1;
+    }
+    newCap = h->cap ? h->cap * 2 : 1024;
+    while(newCap < h->cnt + n){
+        newCap *= 2;
+    }
+    if((p = realloc(h->user, newCap * sizeof(int))) == NULL){
+        return 0;
+    }
+    h->user = p;
+    if((p = realloc(h->batch, newCap * sizeof(int))) == NULL){
+        return 0;
+    }
+    h->batch = p;
+    if((p = realloc(h->vType, newCap * sizeof(int))) == NULL){
+        return 0;
+    }
+    h->vType = p;
+    if((p = realloc(h->date, newCap * sizeof(int))) == NULL){
+        return 0;
+    }
+    h->date = p;
+    if((p = realloc(h->nextUser, newCap * sizeof(int))) == NULL){
+        return 0;
+    }
+    h->nextUser = p;
+    if((p = realloc(h->live, newCap / 8)) == NULL){
+        return 0;
+    }
+    h->live = p;
+    memset(h->live + h->cap / 8, 0, (newCap - h->cap) / 8);
+    h->cap = newCap;
+    return 1;
+}
+
+/**
+  * @brief Appends a live record.
+  *
+  * reserveHistory() must have been called first.
+  *
+  * @param h Pointer to the history.
+  * @param user User id.
+  * @param batch Batch id.
+  * @param vType Vaccine name id.
+  * @param date Packed date.
+  * @return Index of the new record.
+  */
+int appendHistory(History *h, int user, int batch, int vType, int date){
+    int i = h->cnt++;
+    h->user[i] = user;
+    h->batch[i] = batch;
+    h->vType[i] = vType;
+    h->date[i] = date;
+    h->nextUser[i] = -1;
+    h->live[i / 8] |= (unsigned char)(1 << (i % 8));
+    return i;
+}
+
+/**
+  * @brief Tells whether a record has not been deleted.
+  *
+  * @param h Pointer to the history.
+  * @param i Index of the record.
+  * @return 1 if the record is live, 0 otherwise.
+  */
+int isLive(History *h, int i){
+    return (h->live[i / 8] >> (i % 8)) & 1;
+}
+
+/**
+  * @brief Finds the first record made on or after a date.
+  *
+  * Records are appended in order of application and the current date
+  * never goes back, so the date column is sorted, deleted records
+  * included, and can be searched.
+  *
+  * @param h Pointer to the history.
+  * @param date Packed date.
+  * @return Index of the record, or h->cnt if there is none.
+  */
+int findDate(History *h, int date){
+    int lo = 0, hi = h->cnt;
+    while(lo < hi){
+        int mid = lo + (hi - lo) / 2;
+        if(h->date[mid] < date){
+            lo = mid + 1;
+        }else{
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/**
+  * @brief Marks a record as deleted.
+  *
+  * @param h Pointer to the history.
+  * @param i Index of the record.
+  */
+void killRecord(History *h, int i){
+    h->live[i / 8] &= (unsigned char)~(1 << (i % 8));
+    h->dead++;
+}
+
+/**
+  * @brief Drops the deleted records, moving the live ones down.
+  *
+  * Records keep their relative order. The user chains are renumbered
+  * here; anything else that refers to records must be renumbered by the
+  * caller with the map filled in to.
+  *
+  * @param h Pointer to the history.
+  * @param to Filled with the new index of each live record (size cnt).
+  */
+void compactHistory(History *h, int *to){
+    int r, j = 0;
+    for(r = 0; r < h->cnt; r++){
+        to[r] = isLive(h, r) ? j++ : -1;
+    }
+    /* Records only move down, so copying forward is safe */
+    for(r = 0; r < h->cnt; r++){
+        if(to[r] != -1){
+            j = to[r];
+            h->user[j] = h->user[r];
+            h->batch[j] = h->batch[r];
+            h->vType[j] = h->vType[r];
+            h->date[j] = h->date[r];
+            h->nextUser[j] = h->nextUser[r] == -1 ? -1 : to[h->nextUser[r]];
+        }
+    }
+    h->cnt -= h->dead;
+    h->dead = 0;
+    memset(h->live, 0, h->cap / 8);
+    memset(h->live, 0xFF, h->cnt / 8);
+    for(r = h->cnt / 8 * 8; r < h->cnt; r++){
+        h->live[r / 8] |= (unsigned char)(1 << (r % 8));
+    }
+}
+
+/**
+  * @brief Frees all memory used by the history.
+  *
+  * @param h Pointer to the history.
+  */
+void freeHistory(History *h){
+    free(h->user);
+    free(h->batch);
+    free(h->vType);
+    free(h->date);
+    free(h->nextUser);
+    free(h->live);
+    memset(h, 0, sizeof(History));
+}
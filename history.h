@@ -0,0 +1,16 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include "project.h"
+
+
+/* Function prototypes related to the inoculation records */
+int reserveHistory(History *h, int n);
+int appendHistory(History *h, int user, int batch, int vType, int date);
+int isLive(History *h, int i);
+int findDate(History *h, int date);
+void killRecord(History *h, int i);
+void compactHistory(History *h, int *to);
+void freeHistory(History *h);
+
+#endif /* HISTORY_H */
@@ -5,185 +5,291 @@
 
 #include "inoculations.h"
 #include "vaccine.h"
+#include "nameindex.h"
+#include "batchindex.h"
+#include "userindex.h"
+#include "dayset.h"
+#include "history.h"
+#include "parser.h"
+#include "output.h"
 #include "utils.h"
+#include "scan.h"
+#include "summary.h"
 
 /**
-  * @brief Applies a vaccine to a user.
+  * @brief Applies a dose of an already resolved vaccine to a user.
   *
-  * Reads the user's name (which may be quoted) and the vaccine name, then
-  * updates the corresponding batch and records the inoculation.
+  * Prints the batch used, or the reason why no dose was applied.
   *
   * @param sys Pointer to the system.
-  * @param in Input string.
+  * @param vaccId Id of the vaccine name, or -1 if it is unknown.
+  * @param userName Name of the user.
   */
-void applyVaccine(Sys *sys, char *in){
-    char vaccName[MAXNAMEVACC];
-    char tempName[BUFMAX];
-    int i, j, exists = 0;
+static void applyDose(Sys *sys, int vaccId, const char *userName){
+    int r, userId;
+    Vaccine *v;
+    NameEntry *e = vaccId == -1 ? NULL : &sys->names.list[vaccId];
+    UserEntry *user;
  
-    char *ptr = in + 2;
-     
-    if (*ptr == '"'){
-        ptr++;
-        char *end = strchr(ptr, '"');
-        if(!end){
-            puts(sys->state == PT ? PTEINVNAME : ENGEINVNAME);
-            return;
-        }
-        *end = '\0';
-        strncpy(tempName, ptr, BUFMAX - 1);
-        tempName[BUFMAX - 1] = '\0';
-        ptr = end + 1;
-    }else{
-        sscanf(ptr, "%s", tempName);
-        ptr += strlen(tempName);
-    }
- 
-    while(*ptr == ' ' || *ptr == '\t'){
-        ptr++;
+    /* The index already knows the oldest batch with doses left */
+    if(e != NULL){
+        mergeNameBatches(sys, e);
     }
-    sscanf(ptr, "%s", vaccName);
- 
-    if(sys->cntV > 0){
-        mergeSort(sys->arr, 0, sys->cntV - 1);
-    }else{
-        puts(sys->state == PT ? PTENOSTOCK : ENGENOSTOCK);
+    if(e == NULL || e->next >= e->cnt){
+        outError(&sys->out, sys->state, PTENOSTOCK, ENGENOSTOCK);
         return;
     }
+    v = &sys->store[e->ids[e->next]];
  
-    for(i = 0; i < sys->cntV; i++){
-        if(strcmp(sys->arr[i].name, vaccName) == 0 &&
-            sys->arr[i].doses > 0) {
-            j = i;
-            exists = 1;
-            break;
-        }
+    /* Only today's inoculations matter for this rule */
+    userId = findUser(&sys->users, userName);
+    if(userId != -1 &&
+        findToday(&sys->today, &sys->hist, userId, vaccId) != -1){
+        outError(&sys->out, sys->state, PTEALRVACC, ENGEALRVACC);
+        return;
     }
  
-    if(!exists){
-        puts(sys->state == PT ? PTENOSTOCK : ENGENOSTOCK);
+    if(!reserveDaySet(&sys->today, &sys->hist, 1) ||
+        !reserveHistory(&sys->hist, 1) ||
+        (userId = addUser(&sys->users, &sys->arena, userName)) == -1){
+        outError(&sys->out, sys->state, PTENOMEMORY, ENGENOMEMORY);
         return;
     }
+    user = &sys->users.list[userId];
  
-    InocNode *current = sys->inocHead;
-    while(current != NULL){
-        if(strcmp(current->inoc.userName, tempName) == 0 &&
-        strcmp(current->inoc.vType, vaccName) == 0 &&
-        compareDates(sys->tcurr, current->inoc.aplication) == 0){
-            puts(sys->state == PT ? PTEALRVACC : ENGEALRVACC);
-            return;
-        }
-        current = current->next;
-    }
+    v->doses -= 1;
+    v->applys += 1;
+    advanceStock(sys, e);
  
-    sys->arr[j].doses -= 1;
-    sys->arr[j].applys += 1;
+    r = appendHistory(&sys->hist, userId, v->id, vaccId,
+        packDate(sys->tcurr));
+    countDoses(sys, vaccId, -1);
+    countRecord(sys, vaccId, sys->hist.date[r], 1);
  
-    InocNode *newNode = malloc(sizeof(InocNode));
-    if(newNode == NULL){
-        puts(sys->state == PT ? PTENOMEMORY : ENGENOMEMORY);
-        return;
+    /* Link the record at the end of the user's own chain */
+    if(user->first == -1){
+        sys->liveUsers++;
+        user->first = r;
+    }else{
+        sys->hist.nextUser[user->last] = r;
     }
+    user->last = r;
+    addToday(&sys->today, &sys->hist, r);
+     
+    outBatch(&sys->out, v->key);
+    outChar(&sys->out, '\n');
+}
+
+/**
+  * @brief Applies a vaccine to a user.
+  *
+  * Reads the user's name (which may be quoted) and the vaccine name, then
+  * updates the corresponding batch and records the inoculation.
+  *
+  * @param sys Pointer to the system.
+  * @param in Input string.
+  */
+void applyVaccine(Sys *sys, char *in){
+    Token name = {"", 0}, vacc = {"", 0};
+    char *cur = in + 1;
  
-    newNode->inoc.aplication = sys->tcurr;
-    newNode->inoc.userName = malloc(strlen(tempName) + 1);
-    if(newNode->inoc.userName == NULL){
-        free(newNode);
-        puts(sys->state == PT ? PTENOMEMORY : ENGENOMEMORY);
+    if(nextName(&cur, &name) < 0){
+        outError(&sys->out, sys->state, PTEINVNAME, ENGEINVNAME);
         return;
     }
-    strcpy(newNode->inoc.userName, tempName);
-    strcpy(newNode->inoc.batch, sys->arr[j].batch);
-    strcpy(newNode->inoc.vType, vaccName);
-    newNode->next = NULL;
+    nextToken(&cur, &vacc);
+    applyDose(sys, findName(&sys->names, vacc.s), name.s);
+}
+
+/**
+  * @brief Applies one vaccine to many users, in order.
+  *
+  * Prints exactly what the 'a' command would for each user in turn. The
+  * vaccine is looked up once, and room for all the records is made
+  * before the first dose is applied.
+  *
+  * @param sys Pointer to the system.
+  * @param in Input string: the vaccine name, then the user names.
+  */
+void bulkApply(Sys *sys, char *in){
+    Token vacc = {"", 0}, name, *users = NULL;
+    char *cur = in + 1;
+    int i, vaccId, found, cnt = 0, cap = 0;
+ 
+    nextToken(&cur, &vacc);
+    while((found = nextName(&cur, &name)) > 0){
+        if(cnt == cap){
+            Token *bigger = realloc(users, (cap ? cap * 2 : 64) *
+                sizeof(Token));
+            if(bigger == NULL){
+                free(users);
+                outError(&sys->out, sys->state, PTENOMEMORY, ENGENOMEMORY);
+                return;
+            }
+            users = bigger;
+            cap = cap ? cap * 2 : 64;
+        }
+        users[cnt++] = name;
+    }
  
-    /* Insert the new node at the end of the inoculations list */
-    if(sys->inocHead == NULL){
-        sys->inocHead = newNode;
-        sys->inocTail = newNode;
-    }else{
-        sys->inocTail->next = newNode;
-        sys->inocTail = newNode;
+    /* Only an optimization: each dose still makes sure it has room */
+    reserveHistory(&sys->hist, cnt);
+    reserveDaySet(&sys->today, &sys->hist, cnt);
+    vaccId = findName(&sys->names, vacc.s);
+    for(i = 0; i < cnt; i++){
+        applyDose(sys, vaccId, users[i].s);
     }
-     
-    printf("%s\n", sys->arr[j].batch);
+    if(found < 0){
+        outError(&sys->out, sys->state, PTEINVNAME, ENGEINVNAME);
+    }
+    free(users);
 }
 
 /**
-  * @brief Frees the linked list of inoculations.
+  * @brief Prints one inoculation as a line of the 'u' listing.
   *
-  * @param head Pointer to the head of the list.
+  * @param sys Pointer to the system.
+  * @param r Index of the record.
   */
-void freeInocList(InocNode *head){
-    InocNode *current = head;
-    while (current != NULL){
-        InocNode *temp = current;
-        current = current->next;
-        free(temp->inoc.userName);
-        free(temp);
+void printInoculation(Sys *sys, int r){
+    outStr(&sys->out, userNameOf(&sys->users, sys->hist.user[r]));
+    outChar(&sys->out, ' ');
+    outBatch(&sys->out, sys->store[sys->hist.batch[r]].key);
+    outChar(&sys->out, ' ');
+    outDate(&sys->out, unpackDate(sys->hist.date[r]));
+    outChar(&sys->out, '\n');
+}
+
+/**
+  * @brief Parses a valid date into its packed form.
+  *
+  * @param tok Token holding the date.
+  * @param packed Filled with the packed date.
+  * @return 1 if the date is valid, 0 otherwise.
+  */
+static int parseDay(Token *tok, int *packed){
+    Date date;
+    if(!parseDate(tok, &date) || !verifyDate(date)){
+        return 0;
     }
+    *packed = packDate(date);
+    return 1;
 }
 
 /**
   * @brief Lists the inoculation history for a user.
   *
-  * If no user is specified, lists all inoculations.
+  * If no user is specified, lists all inoculations. Either can be limited
+  * to the dates from one date to another, both included: the records of
+  * all users are then found by binary search on the date column, and a
+  * user's chain is left as soon as it goes past the last date. The chain
+  * has no index of its own, so a user's range still walks every record
+  * of the user before the first date.
   *
   * @param sys Pointer to the system.
   * @param in Input string.
   */
 void listClientHistory(Sys *sys, char *in){
+    History *h = &sys->hist;
+    Token name, from, to;
+    char *cur = in + 1;
     char *userName = NULL;
-    char *ptr = in + 1;
-    while(*ptr && isspace(*ptr)){
-        ptr++;
+    int found, quoted, hasRange = 0, first = 0, last = 0;
+    while(isspace((unsigned char)*cur)){
+        cur++;
+    }
+    quoted = *cur == '"';
+    found = nextName(&cur, &name);
+    if(found < 0){
+        outError(&sys->out, sys->state, PTEINVNAME, ENGEINVNAME);
+        return;
+    }else if(found){
+        userName = name.s;
     }
-    if(*ptr == '"'){
-        ptr++;
-        char *end = strchr(ptr, '"');
-        if(end == NULL){
-            puts(sys->state == PT ? PTEINVNAME : ENGEINVNAME);
+ 
+    /* "u <from> <to>" is for all users, "u <user> <from> <to>" for one */
+    if(found && nextToken(&cur, &from)){
+        if(!nextToken(&cur, &to)){
+            to = from;
+            from = name;
+            userName = NULL;
+        }
+        if((userName == NULL && quoted) || !parseDay(&from, &first) ||
+            !parseDay(&to, &last)){
+            outError(&sys->out, sys->state, PTEINVDATE, ENGEINVDATE);
             return;
         }
-        *end = '\0';
-        userName = ptr;
-    }else{
-        userName = strtok(ptr, " ");
+        hasRange = 1;
     }
  
     if(userName == NULL){
-        InocNode *atual = sys->inocHead;
-        while(atual != NULL){
-            printf("%s %s %.2d-%.2d-%d\n",
-                atual->inoc.userName,
-                atual->inoc.batch,
-                atual->inoc.aplication.day,
-                atual->inoc.aplication.month,
-                atual->inoc.aplication.year);
-                atual = atual->next;
+        int r = 0, end = h->cnt;
+        if(hasRange){
+            r = findDate(h, first);
+            end = first <= last ? findDate(h, last + 1) : r;
         }
-     }else{
-        InocNode *current = sys->inocHead;
-        int encontrado = 0;
-        while(current != NULL){
-             if(strcmp(current->inoc.userName, userName) == 0){
-                printf("%s %s %.2d-%.2d-%d\n",
-                    current->inoc.userName,
-                    current->inoc.batch,
-                    current->inoc.aplication.day,
-                    current->inoc.aplication.month,
-                    current->inoc.aplication.year);
-                encontrado = 1;
+        if(startScan(sys, 'u', r, end)){
+            return;
+        }
+        for(; r < end; r++){
+            if(isLive(h, r)){
+                printInoculation(sys, r);
             }
-            current = current->next;
         }
-        if(!encontrado){
-            printf("%s: ", userName);
-            puts(sys->state == PT ? PTENOUSER : ENGENOUSER);
+     }else{
+        int userId = findUser(&sys->users, userName);
+        int r = userId == -1 ? -1 : sys->users.list[userId].first;
+        if(r == -1){
+            outStr(&sys->out, userName);
+            outStr(&sys->out, ": ");
+            outError(&sys->out, sys->state, PTENOUSER, ENGENOUSER);
+            return;
+        }
+        /* A user's records are in date order too */
+        for(; r != -1 && (!hasRange || h->date[r] <= last);
+            r = h->nextUser[r]){
+            if(!hasRange || h->date[r] >= first){
+                printInoculation(sys, r);
+            }
         }
     }
 }
  
+/**
+  * @brief Drops the deleted inoculation records.
+  *
+  * Renumbers everything that refers to records: the history's own user
+  * chains, the first and last record of each user and the set of today's
+  * records. Skipped if the renumbering map cannot be allocated, since
+  * deleted records are harmless apart from the space they take. Pending
+  * listings are finished first, as their views are by record index.
+  *
+  * @param sys Pointer to the system.
+  */
+static void compactRecords(Sys *sys){
+    History *h = &sys->hist;
+    int *to = malloc(h->cnt * sizeof(int));
+    int i, r, today = packDate(sys->tcurr);
+    if(to == NULL){
+        return;
+    }
+    finishScans(sys, NULL, 0);
+    compactHistory(h, to);
+    for(i = 0; i < sys->users.keys.cnt; i++){
+        UserEntry *user = &sys->users.list[i];
+        if(user->first != -1){
+            user->first = to[user->first];
+            user->last = to[user->last];
+        }
+    }
+    /* Today's records are the last ones, since dates never go back */
+    clearDaySet(&sys->today);
+    for(r = h->cnt - 1; r >= 0 && h->date[r] == today; r--){
+        addToday(&sys->today, h, r);
+    }
+    free(to);
+}
+
 /**
   * @brief Deletes inoculation records for a given user.
   *
@@ -193,106 +299,88 @@ void listClientHistory(Sys *sys, char *in){
   * @param in Input string containing parameters.
   */
 void deleteHistory(Sys *sys, char *in){
-    char *userName = NULL;
-    char *ptr = in + 1;
-    while(*ptr && isspace(*ptr)){
-        ptr++;
-    }
-    if(*ptr == '"'){
-        ptr++;
-        char *end = strchr(ptr, '"');
-        if(end == NULL){
-            printf("%s: ", ptr);
-            puts(sys->state == PT ? PTEINVNAME : ENGEINVNAME);
-            return;
-        }
-        *end = '\0';
-        userName = ptr;
-        ptr = end + 1;
-    }else{
-        userName = strtok(ptr, " ");
+    Token name = {"", 0}, token;
+    char *cur = in + 1;
+    char *userName;
+    if(nextName(&cur, &name) < 0){
+        outStr(&sys->out, name.s);
+        outStr(&sys->out, ": ");
+        outError(&sys->out, sys->state, PTEINVNAME, ENGEINVNAME);
+        return;
     }
+    userName = name.s;
      
     int hasDate = 0;
     Date date;
-    char *dateToken = strtok(NULL, " ");
-    if(dateToken != NULL){
-        if(sscanf(dateToken, "%d-%d-%d",
-            &date.day, &date.month, &date.year)!=3 ||
-            !verifyDate(date) ||
+    if(nextToken(&cur, &token)){
+        if(!parseDate(&token, &date) || !verifyDate(date) ||
             (compareDates(date, sys->tcurr) > 0)){
-            puts(sys->state == PT ? PTEINVDATE : ENGEINVDATE);
+            outError(&sys->out, sys->state, PTEINVDATE, ENGEINVDATE);
             return;
         }
         hasDate = 1;
     }
      
-    int hasBatch = 0;
-    char *batchToken = strtok(NULL, " ");
-    if(batchToken != NULL){
+    int hasBatch = 0, batchId = -1;
+    if(nextToken(&cur, &token)){
+        BatchKey key;
+        batchId = parseBatch(&token, &key) ? findBatch(sys, &key) : -1;
         hasBatch = 1;
-        int foundBatch = 0;
-        for(int i = 0; i < sys->cntV; i++){
-            if(strcmp(sys->arr[i].batch, batchToken) == 0){
-                foundBatch = 1;
-                break;
-            }
-        }
-        if(!foundBatch){
-            printf("%s: ", batchToken);
-            puts(sys->state == PT ? PTENOBATCH : ENGENOBATCH);
+        if(batchId == -1){
+            outStr(&sys->out, token.s);
+            outStr(&sys->out, ": ");
+            outError(&sys->out, sys->state, PTENOBATCH, ENGENOBATCH);
             return;
         }
     }
      
-    InocNode *prev = NULL, *curr = sys->inocHead;
+    int userId = findUser(&sys->users, userName);
+    UserEntry *user = userId == -1 ? NULL : &sys->users.list[userId];
+    if(user == NULL || user->first == -1){
+        outStr(&sys->out, userName);
+        outStr(&sys->out, ": ");
+        outError(&sys->out, sys->state, PTENOUSER, ENGENOUSER);
+        return;
+    }
+ 
+    /* Only this user's chain is visited */
+    History *h = &sys->hist;
+    int packed = hasDate ? packDate(date) : 0;
+    int today = packDate(sys->tcurr);
+    int prev = -1, curr = user->first;
     int deletedCount = 0;
-    int userFound = 0;
      
-    while(curr != NULL){
-        int match = 0;
-        if(strcmp(curr->inoc.userName, userName) == 0){
-            userFound = 1;
-            match = 1;
-            if(hasDate){
-                if(curr->inoc.aplication.day != date.day ||
-                    curr->inoc.aplication.month != date.month ||
-                    curr->inoc.aplication.year != date.year){
-                    match = 0;
-                }
-            }
-            if(match && hasBatch){
-                if(strcmp(curr->inoc.batch, batchToken) != 0){
-                    match = 0;
-                }
-            }
-        }
-         
-        if(match){
-            InocNode *temp = curr;
-            if(prev == NULL){
-                sys->inocHead = curr->next;
+    /* The chain is in date order, so it ends for good past the date */
+    while(curr != -1 && (!hasDate || h->date[curr] <= packed)){
+        int next = h->nextUser[curr];
+        if((!hasDate || h->date[curr] == packed) &&
+            (!hasBatch || h->batch[curr] == batchId)){
+            if(prev == -1){
+                user->first = next;
             }else{
-                prev->next = curr->next;
+                h->nextUser[prev] = next;
+            }
+            if(curr == user->last){
+                user->last = prev;
             }
-            if(curr == sys->inocTail){
-                sys->inocTail = prev;
+            if(h->date[curr] == today){
+                removeToday(&sys->today, h, curr);
             }
-            curr = curr->next;
-            free(temp->inoc.userName);
-            free(temp);
+            countRecord(sys, h->vType[curr], h->date[curr], -1);
+            killRecord(h, curr);
             deletedCount++;
         }else{
             prev = curr;
-            curr = curr->next;
         }
+        curr = next;
     }
      
-    if(!userFound){
-        printf("%s: ", userName);
-        puts(sys->state == PT ? PTENOUSER : ENGENOUSER);
-        return;
+    if(deletedCount > 0 && user->first == -1){
+        sys->liveUsers--;
     }
-     
-    printf("%d\n", deletedCount);
-}
\ No newline at end of file
+    outInt(&sys->out, deletedCount);
+    outChar(&sys->out, '\n');
+    if(worthCompacting(sys, h->dead, h->cnt)){
+        compactRecords(sys);
+    }
+}
@@ -6,7 +6,8 @@
 
 /* Function prototypes related to inoculations */
 void applyVaccine(Sys *sys, char *in);
-void freeInocList(InocNode *head);
+void bulkApply(Sys *sys, char *in);
+void printInoculation(Sys *sys, int r);
 void listClientHistory(Sys *sys, char *in);
 void deleteHistory(Sys *sys, char *in);
 
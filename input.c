@@ -0,0 +1,165 @@
+/**
+ * @file input.c
+ * @brief Reading of command lines from a file or from standard input.
+ *
+ * Lines are returned as pointers into the reader's own buffer, with the
+ * newline replaced by a terminator, so the dispatcher never copies them.
+ */
+
+#include "input.h"
+
+/**
+  * @brief Loads a whole command file into memory.
+  *
+  * @param in Pointer to the reader.
+  * @return 1 on success, 0 if the file cannot be read or memory is
+  *         exhausted.
+  */
+static int loadFile(Input *in){
+    long size;
+    if(fseek(in->fp, 0, SEEK_END) != 0 || (size = ftell(in->fp)) < 0 ||
+        fseek(in->fp, 0, SEEK_SET) != 0){
+        return 0;
+    }
+    in->cap = (size_t)size + 1;
+    in->buf = malloc(in->cap);
+    if(in->buf == NULL){
+        return 0;
+    }
+    in->len = fread(in->buf, 1, (size_t)size, in->fp);
+    in->buf[in->len] = '\0';
+    in->whole = 1;
+    return 1;
+}
+
+/**
+  * @brief Loads all of standard input into memory.
+  *
+  * Reads in chunks of INCHUNK bytes until the end of the stream.
+  *
+  * @param in Pointer to the reader.
+  * @return 1 on success, 0 if memory is exhausted.
+  */
+static int loadStream(Input *in){
+    size_t n;
+    in->cap = INCHUNK;
+    in->buf = malloc(in->cap);
+    while(in->buf != NULL &&
+        (n = fread(in->buf + in->len, 1, in->cap - in->len - 1, in->fp)) > 0){
+        in->len += n;
+        if(in->len + 1 == in->cap){
+            char *bigger = realloc(in->buf, in->cap * 2);
+            if(bigger == NULL){
+                free(in->buf);
+                in->buf = NULL;
+                return 0;
+            }
+            in->buf = bigger;
+            in->cap *= 2;
+        }
+    }
+    if(in->buf == NULL){
+        return 0;
+    }
+    in->buf[in->len] = '\0';
+    in->whole = 1;
+    return 1;
+}
+
+/**
+  * @brief Opens a source of commands.
+  *
+  * @param in Pointer to the reader.
+  * @param path Command file to read, or NULL for standard input.
+  * @param bulk 1 to read all of standard input before the first line is
+  *        returned, instead of line by line.
+  * @return 1 on success, 0 otherwise.
+  */
+int openInput(Input *in, const char *path, int bulk){
+    memset(in, 0, sizeof(Input));
+    if(path == NULL && bulk){
+        in->fp = stdin;
+        return loadStream(in);
+    }
+    if(path == NULL){
+        in->fp = stdin;
+        /* A large stdio buffer means few reads even for short lines */
+        setvbuf(stdin, NULL, _IOFBF, INCHUNK);
+        in->cap = LINEINIT;
+        in->buf = malloc(in->cap);
+        return in->buf != NULL;
+    }
+    in->fp = fopen(path, "rb");
+    if(in->fp == NULL){
+        return 0;
+    }
+    return loadFile(in);
+}
+
+/**
+  * @brief Returns the next line of a command file.
+  *
+  * @param in Pointer to the reader.
+  * @return The line, or NULL at the end of the file.
+  */
+static char *nextFileLine(Input *in){
+    char *line, *end;
+    if(in->pos >= in->len){
+        return NULL;
+    }
+    line = in->buf + in->pos;
+    end = memchr(line, '\n', in->len - in->pos);
+    if(end == NULL){
+        in->pos = in->len;
+    }else{
+        *end = '\0';
+        in->pos = (size_t)(end - in->buf) + 1;
+    }
+    return line;
+}
+
+/**
+  * @brief Returns the next line, without its newline.
+  *
+  * The line stays valid until the next call.
+  *
+  * @param in Pointer to the reader.
+  * @return The line, or NULL at the end of the input or if memory is
+  *         exhausted.
+  */
+char *nextLine(Input *in){
+    size_t n = 0;
+    if(in->whole){
+        return nextFileLine(in);
+    }
+    while(fgets(in->buf + n, (int)(in->cap - n), in->fp)){
+        n += strlen(in->buf + n);
+        if(n > 0 && in->buf[n - 1] == '\n'){
+            in->buf[n - 1] = '\0';
+            return in->buf;
+        }
+        if(n + 1 == in->cap){
+            char *bigger = realloc(in->buf, in->cap * 2);
+            if(bigger == NULL){
+                in->nomem = 1;
+                return NULL;
+            }
+            in->buf = bigger;
+            in->cap *= 2;
+        }
+    }
+    return n > 0 ? in->buf : NULL;
+}
+
+/**
+  * @brief Releases the reader.
+  *
+  * @param in Pointer to the reader.
+  */
+void closeInput(Input *in){
+    if(in->fp != NULL && in->fp != stdin){
+        fclose(in->fp);
+    }
+    free(in->buf);
+    in->buf = NULL;
+}
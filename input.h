@@ -0,0 +1,12 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include "project.h"
+
+
+/* Function prototypes related to reading commands */
+int openInput(Input *in, const char *path, int bulk);
+char *nextLine(Input *in);
+void closeInput(Input *in);
+
+#endif /* INPUT_H */
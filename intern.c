@@ -0,0 +1,114 @@
+/**
+ * @file intern.c
+ * @brief String interning: each distinct string is stored once and named
+ * by a small integer id.
+ *
+ * The strings live in the system's arena; the table only keeps ids, so
+ * comparing two interned strings is an integer compare.
+ */
+
+#include "intern.h"
+#include "arena.h"
+#include "utils.h"
+
+/**
+  * @brief Returns the slot where a string is or should be stored.
+  *
+  * @param t Pointer to the table (with at least one free slot).
+  * @param s String.
+  * @return Index of the matching or first empty slot.
+  */
+static int internSlot(Intern *t, const char *s){
+    int mask = t->size - 1;
+    int i = (int)(hashString(s) & (unsigned long)mask);
+    while(t->tab[i] != -1 && strcmp(t->strs[t->tab[i]], s)){
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+/**
+  * @brief Looks up the id of a string.
+  *
+  * @param t Pointer to the table.
+  * @param s String.
+  * @return The id, or -1 if the string was never interned.
+  */
+int internFind(Intern *t, const char *s){
+    if(t->size == 0){
+        return -1;
+    }
+    return t->tab[internSlot(t, s)];
+}
+
+/**
+  * @brief Makes sure one more string can be interned.
+  *
+  * @param t Pointer to the table.
+  * @return 1 on success, 0 if memory is exhausted.
+  */
+static int growIntern(Intern *t){
+    if(t->cnt == t->cap){
+        int newCap = t->cap ? t->cap * 2 : 16;
+        char **strs = realloc(t->strs, newCap * sizeof(char *));
+        if(strs == NULL){
+            return 0;
+        }
+        t->strs = strs;
+        t->cap = newCap;
+    }
+    if(2 * (t->cnt + 1) > t->size){
+        int i, newSize = t->size ? t->size * 2 : 32;
+        int *tab = malloc(newSize * sizeof(int));
+        if(tab == NULL){
+            return 0;
+        }
+        for(i = 0; i < newSize; i++){
+            tab[i] = -1;
+        }
+        free(t->tab);
+        t->tab = tab;
+        t->size = newSize;
+        for(i = 0; i < t->cnt; i++){
+            t->tab[internSlot(t, t->strs[i])] = i;
+        }
+    }
+    return 1;
+}
+
+/**
+  * @brief Returns the id of a string, interning it if needed.
+  *
+  * @param t Pointer to the table.
+  * @param arena Arena that will hold a copy of a new string.
+  * @param s String.
+  * @return The id, or -1 if memory is exhausted.
+  */
+int internAdd(Intern *t, Arena *arena, const char *s){
+    int i, id = internFind(t, s);
+    char *copy;
+ 
+    if(id != -1){
+        return id;
+    }
+    if(!growIntern(t) || (copy = arenaStrdup(arena, s)) == NULL){
+        return -1;
+    }
+    i = internSlot(t, s);
+    t->strs[t->cnt] = copy;
+    t->tab[i] = t->cnt;
+    return t->cnt++;
+}
+
+/**
+  * @brief Frees the table. The strings belong to the arena.
+  *
+  * @param t Pointer to the table.
+  */
+void freeIntern(Intern *t){
+    free(t->tab);
+    free(t->strs);
+    t->tab = NULL;
+    t->strs = NULL;
+    t->size = t->cnt = t->cap = 0;
+}
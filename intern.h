@@ -0,0 +1,12 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include "project.h"
+
+
+/* Function prototypes related to string interning */
+int internFind(Intern *t, const char *s);
+int internAdd(Intern *t, Arena *arena, const char *s);
+void freeIntern(Intern *t);
+
+#endif /* INTERN_H */
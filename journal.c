@@ -0,0 +1,275 @@
+/**
+ * @file journal.c
+ * @brief Write-ahead journal of the commands that change the system.
+ *
+ * Every command that may change the system is appended to the journal
+ * before it runs. On startup the journal is replayed with its output
+ * discarded, which brings the system back to where it was when the
+ * previous run stopped. A record cut short by a crash fails its length
+ * or checksum test; replay stops there and the torn tail is dropped.
+ *
+ * Records are flushed in groups of Journal::every, trading the last few
+ * commands before a crash for fewer writes. Each run also starts with an
+ * "M <n> <gen>" record: its limit on batches, so that replay never runs
+ * with a smaller limit than the commands it replays did, and the
+ * generation of the last snapshot saved. A snapshot holds every command
+ * of the generations before its own, so replay skips those; they are
+ * only left in the journal when the program stopped between renaming a
+ * new snapshot into place and starting the journal over.
+ */
+
+#include "journal.h"
+#include "system.h"
+#include "output.h"
+#include "utils.h"
+#include "parser.h"
+
+/**
+  * @brief Reads one record into a growable line buffer.
+  *
+  * @param fp Journal being replayed.
+  * @param left Bytes of the file not read yet.
+  * @param line Pointer to the line buffer.
+  * @param cap Pointer to the allocated size of the line buffer.
+  * @return Size of the record in the file, 0 at the end of the journal
+  *         or at a torn record, -1 if memory is exhausted.
+  */
+static long readRecord(FILE *fp, long left, char **line, size_t *cap){
+    unsigned int len, sum;
+    if(left < (long)(2 * sizeof(unsigned int)) ||
+        fread(&len, sizeof(len), 1, fp) != 1 ||
+        len > left - 2 * sizeof(unsigned int)){
+        return 0;
+    }
+    if(len + 1 > *cap){
+        char *bigger = realloc(*line, len + 1);
+        if(bigger == NULL){
+            return -1;
+        }
+        *line = bigger;
+        *cap = len + 1;
+    }
+    if(fread(*line, 1, len, fp) != len ||
+        fread(&sum, sizeof(sum), 1, fp) != 1 ||
+        sum != (unsigned int)checksum(FNVSEED, *line, len)){
+        return 0;
+    }
+    (*line)[len] = '\0';
+    return len + 2 * sizeof(unsigned int);
+}
+
+/**
+  * @brief Replays every whole record of a journal, discarding the output.
+  *
+  * @param sys Pointer to the system.
+  * @param fp Journal being replayed.
+ * @param good Set to the size of the records that were replayed.
+  * @param stale Set to 1 if every command was skipped as older than the
+  *        loaded snapshot, 0 otherwise.
+  * @return 1 if the whole file was replayed, 0 if it ends with a torn
+  *         record, -1 if memory is exhausted.
+  */
+static int replayJournal(Sys *sys, FILE *fp, long *good, int *stale){
+    FILE *screen = sys->out.fp;
+    char *line = NULL;
+    size_t cap = 0;
+    long size, n;
+    /* Commands before any "M" record are of generation 0 */
+    int skip = sys->gen > 0, ran = 0, skipped = 0;
+ 
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    rewind(fp);
+    *good = 0;
+    sys->out.fp = NULL;
+    while((n = readRecord(fp, size - *good, &line, &cap)) > 0){
+        if(line[0] == 'M'){
+            char *cur = line + 1;
+            Token t;
+            int maxV, gen = 0;
+            if(nextToken(&cur, &t) && parseInt(&t, &maxV) &&
+                maxV > sys->maxV){
+                sys->maxV = maxV;
+            }
+            if(nextToken(&cur, &t) && !parseInt(&t, &gen)){
+                gen = 0;
+            }
+            skip = gen < sys->gen;
+            if(gen > sys->gen){
+                sys->gen = gen;
+            }
+            *good += n;
+            continue;
+        }
+        if(skip){
+            skipped++;
+        }else{
+            runCommand(sys, line);
+            outFlush(&sys->out);
+            ran++;
+        }
+        *good += n;
+    }
+    sys->out.fp = screen;
+    free(line);
+    *stale = skipped > 0 && ran == 0;
+    return n < 0 ? -1 : *good == size;
+}
+
+/**
+  * @brief Cuts a journal down to its first bytes.
+  *
+  * The kept bytes are copied to a temporary file that then replaces the
+  * journal.
+  *
+  * @param path Journal file.
+  * @param keep Number of bytes to keep.
+  * @return 1 on success, 0 otherwise.
+  */
+static int cutJournal(const char *path, long keep){
+    char *tmp = malloc(strlen(path) + 5);
+    char chunk[4096];
+    FILE *src, *dst;
+    int ok = 1;
+ 
+    if(tmp == NULL){
+        return 0;
+    }
+    strcpy(tmp, path);
+    strcat(tmp, ".tmp");
+    src = fopen(path, "rb");
+    dst = src == NULL ? NULL : fopen(tmp, "wb");
+    while(dst != NULL && ok && keep > 0){
+        size_t n = keep < (long)sizeof(chunk) ? (size_t)keep : sizeof(chunk);
+        ok = fread(chunk, 1, n, src) == n && fwrite(chunk, 1, n, dst) == n;
+        keep -= n;
+    }
+    if(src != NULL){
+        fclose(src);
+    }
+    if(dst == NULL || fclose(dst) != 0){
+        ok = 0;
+    }
+    if(!ok || rename(tmp, path) != 0){
+        remove(tmp);
+        ok = 0;
+    }
+    free(tmp);
+    return ok;
+}
+
+/**
+  * @brief Appends a record to the journal, flushing once a group is full.
+  *
+  * @param j Pointer to the journal.
+  * @param line Line of the record.
+  */
+static void writeRecord(Journal *j, const char *line){
+    unsigned int len = (unsigned int)strlen(line);
+    unsigned int sum = (unsigned int)checksum(FNVSEED, line, len);
+    fwrite(&len, sizeof(len), 1, j->fp);
+    fwrite(line, 1, len, j->fp);
+    fwrite(&sum, sizeof(sum), 1, j->fp);
+    if(++j->pending >= j->every){
+        fflush(j->fp);
+        j->pending = 0;
+    }
+}
+
+/**
+  * @brief Records the limit on batches and the snapshot generation of the
+  * current run.
+  *
+  * @param j Pointer to the journal.
+  * @param maxV Most batches allowed at the same time.
+  * @param gen Generation of the last snapshot saved.
+  */
+static void logRun(Journal *j, int maxV, int gen){
+    char line[32];
+    sprintf(line, "M %d %d", maxV, gen);
+    writeRecord(j, line);
+}
+
+/**
+  * @brief Replays a journal, if there is one, and opens it for appending.
+  *
+  * A journal that only holds commands older than the loaded snapshot is
+  * started over instead.
+  *
+  * @param sys Pointer to the system.
+  * @param path Journal file.
+  * @param every Number of records written between flushes.
+  * @return 1 on success, 0 if the journal cannot be replayed or opened.
+  */
+int openJournal(Sys *sys, const char *path, int every){
+    Journal *j = &sys->journal;
+    FILE *fp = fopen(path, "rb");
+    int stale = 0;
+    j->path = path;
+    j->every = every > 0 ? every : 1;
+    j->pending = 0;
+    if(fp != NULL){
+        long good;
+        int whole = replayJournal(sys, fp, &good, &stale);
+        fclose(fp);
+        if(whole < 0 || (whole == 0 && !cutJournal(path, good))){
+            return 0;
+        }
+    }
+    j->fp = fopen(path, stale ? "wb" : "ab");
+    if(j->fp == NULL){
+        return 0;
+    }
+    logRun(j, sys->maxV, sys->gen);
+    return 1;
+}
+
+/**
+  * @brief Appends a command to the journal if it may change the system.
+  *
+  * Must be called before the command runs, since running it tokenizes
+  * the line in place.
+  *
+  * @param j Pointer to the journal.
+  * @param line Command line.
+  */
+void logCommand(Journal *j, const char *line){
+    if(j->fp == NULL || line[0] == '\0' || strchr("cabrdt", line[0]) == NULL){
+        return;
+    }
+    writeRecord(j, line);
+}
+
+/**
+  * @brief Empties the journal once a snapshot holds everything in it.
+  *
+  * @param j Pointer to the journal.
+  * @param maxV Most batches allowed at the same time.
+  * @param gen Generation of the snapshot.
+  * @return 1 on success (or if there is no journal), 0 otherwise.
+  */
+int restartJournal(Journal *j, int maxV, int gen){
+    if(j->fp == NULL){
+        return 1;
+    }
+    fclose(j->fp);
+    j->fp = fopen(j->path, "wb");
+    j->pending = 0;
+    if(j->fp == NULL){
+        return 0;
+    }
+    logRun(j, maxV, gen);
+    return 1;
+}
+
+/**
+  * @brief Flushes and closes the journal.
+  *
+  * @param j Pointer to the journal.
+  */
+void closeJournal(Journal *j){
+    if(j->fp != NULL){
+        fclose(j->fp);
+        j->fp = NULL;
+    }
+}
@@ -0,0 +1,13 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "project.h"
+
+
+/* Function prototypes related to the command journal */
+int openJournal(Sys *sys, const char *path, int every);
+void logCommand(Journal *j, const char *line);
+int restartJournal(Journal *j, int maxV, int gen);
+void closeJournal(Journal *j);
+
+#endif /* JOURNAL_H */
@@ -0,0 +1,66 @@
+/**
+ * @file latency.c
+ * @brief Log-scale latency histograms.
+ *
+ * Buckets are spaced logarithmically, LATSUB per power of two, so a
+ * percentile read off a histogram is exact to within 1 / LATSUB of its
+ * value whatever the scale. Used by the command counters and by the
+ * benchmark tools.
+ */
+
+#include "latency.h"
+
+/**
+  * @brief Returns the latency bucket of a duration.
+  *
+  * @param ns Duration in nanoseconds.
+  * @return Index of the bucket.
+  */
+int latBucket(long ns){
+    int e = 0;
+    if(ns < 2 * LATSUB){
+        return ns < 0 ? 0 : (int)ns;
+    }
+    while((ns >> e) >= 2 * LATSUB){
+        e++;
+    }
+    /* ns >> e is now in [LATSUB, 2 * LATSUB) */
+    e = (e + 1) * LATSUB + (int)(ns >> e) - LATSUB;
+    return e < LATBUCKETS ? e : LATBUCKETS - 1;
+}
+
+/**
+  * @brief Returns the longest duration that falls in a latency bucket.
+  *
+  * @param b Index of the bucket.
+  * @return Duration in nanoseconds.
+  */
+long latTop(int b){
+    if(b < 2 * LATSUB){
+        return b;
+    }
+    return ((long)(b % LATSUB + LATSUB + 1) << (b / LATSUB - 1)) - 1;
+}
+
+/**
+  * @brief Returns a latency percentile of a histogram.
+  *
+  * @param bucket Durations per bucket, LATBUCKETS of them.
+  * @param count Durations in the histogram.
+  * @param p Percentile, in (0, 100].
+  * @return Upper bound of the percentile in nanoseconds.
+  */
+long latPercentile(const long *bucket, long count, double p){
+    long rank = (long)(count * p / 100.0 + 0.5), seen = 0;
+    int b;
+    if(rank < 1){
+        rank = 1;
+    }
+    for(b = 0; b < LATBUCKETS; b++){
+        seen += bucket[b];
+        if(seen >= rank){
+            return latTop(b);
+        }
+    }
+    return latTop(LATBUCKETS - 1);
+}
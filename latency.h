@@ -0,0 +1,11 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include "project.h"
+
+/* Function prototypes related to latency histograms */
+int latBucket(long ns);
+long latTop(int b);
+long latPercentile(const long *bucket, long count, double p);
+
+#endif /* LATENCY_H */
@@ -2,51 +2,155 @@
  * @file main.c
  * @brief Main function of the vaccine management system.
  *
- * Reads commands from standard input and processes them.
+ * Reads commands from standard input, or from a command file given with
+ * --input, and processes them.
  */
 
 #include "project.h"
-#include "utils.h"
-#include "vaccine.h"
-#include "inoculations.h"
-#include "time.h"
+#include "system.h"
+#include "snapshot.h"
+#include "journal.h"
+#include "parser.h"
+#include "stats.h"
+#include "output.h"
+#include "input.h"
+#include "scan.h"
 
 /**
   * @brief Main function.
   *
-  * Reads commands from standard input and processes them.
+  * Reads commands and processes them. Arguments: "pt" selects Portuguese
+  * error messages, "--input <file>" reads the commands from a file,
+  * "--load <file>" starts from a snapshot saved with the 'w' command and
+  * "--journal <file>" replays and then extends a journal of the commands
+  * that change the system, flushed every "--sync <n>" records.
+  * "--max-batches <n>" sets how many batches may exist at the same time
+  * and "--compact <p>" how much of the batches or records, in percent,
+  * may be deleted but not yet compacted away.
+  * "--pipeline" reads all the commands before running them and writes
+  * their results in large blocks instead of after every command.
+  * When built with -DSTATS, "--stats" prints the counters when quitting.
   *
   * @param argc Argument count.
   * @param argv Argument vector.
-  * @return 0 on success.
+  * @return 0 on success, 1 if the command file, snapshot or journal
+  *         cannot be read.
   */
 int main(int argc, char *argv[]){
-    char buf[BUFMAX];
-    Sys sys = {0, {}, NULL, NULL, ENG, {1, 1, 2025}};
+    char *buf;
+    const char *path = NULL, *snap = NULL, *log = NULL;
+    int pt = 0, every = 1, pipelined = 0;
+    Input input;
+    Sys *sys = newSys();
+ 
+    if(sys == NULL){
+        puts(ENGENOMEMORY);
+        return 1;
+    }
      
-    if (argc > 1) {
-        if(strcmp(argv[1], "pt") == 0){
-            sys.state = PT;
+    for(int i = 1; i < argc; i++){
+        if(strcmp(argv[i], "pt") == 0){
+            pt = 1;
+        }else if(strcmp(argv[i], "--input") == 0 && i + 1 < argc){
+            path = argv[++i];
+        }else if(strcmp(argv[i], "--load") == 0 && i + 1 < argc){
+            snap = argv[++i];
+        }else if(strcmp(argv[i], "--pipeline") == 0){
+            pipelined = 1;
+        }else if(strcmp(argv[i], "--journal") == 0 && i + 1 < argc){
+            log = argv[++i];
+        }else if(strcmp(argv[i], "--sync") == 0 && i + 1 < argc){
+            Token n = {argv[i + 1], (int)strlen(argv[i + 1])};
+            i++;
+            if(!parseInt(&n, &every)){
+                every = 1;
+            }
+        }else if(strcmp(argv[i], "--max-batches") == 0 && i + 1 < argc){
+            Token n = {argv[i + 1], (int)strlen(argv[i + 1])};
+            i++;
+            if(!parseInt(&n, &sys->maxV) || sys->maxV < 1){
+                sys->maxV = MAXBATCHES;
+            }
+        }else if(strcmp(argv[i], "--compact") == 0 && i + 1 < argc){
+            Token n = {argv[i + 1], (int)strlen(argv[i + 1])};
+            i++;
+            if(!parseInt(&n, &sys->compactPct) || sys->compactPct < 0){
+                sys->compactPct = COMPACTPCT;
+            }
+#ifdef STATS
+        }else if(strcmp(argv[i], "--stats") == 0){
+            sys->stats.atQuit = 1;
+#endif
+        }
+    }
+ 
+    if(snap != NULL && !loadSnapshot(sys, snap)){
+        sys->state = pt ? PT : ENG;
+        outStr(&sys->out, snap);
+        outStr(&sys->out, ": ");
+        outError(&sys->out, sys->state, PTEBADSNAP, ENGEBADSNAP);
+        outFlush(&sys->out);
+        freeSys(sys);
+        return 1;
+    }
+    if(log != NULL && !openJournal(sys, log, every)){
+        sys->state = pt ? PT : sys->state;
+        outStr(&sys->out, log);
+        outStr(&sys->out, ": ");
+        outError(&sys->out, sys->state, PTEBADJOURNAL, ENGEBADJOURNAL);
+        outFlush(&sys->out);
+        freeSys(sys);
+        return 1;
+    }
+    if(pt){
+        sys->state = PT;
+    }
+ 
+    if(!openInput(&input, path, pipelined)){
+        if(path != NULL){
+            perror(path);
+        }else{
+            outError(&sys->out, sys->state, PTENOMEMORY, ENGENOMEMORY);
+            outFlush(&sys->out);
         }
+        closeInput(&input);
+        freeSys(sys);
+        return 1;
     }
  
-    while(fgets(buf, BUFMAX, stdin)){
-        buf[strcspn(buf, "\n")] = 0;
-        switch(buf[0]){
-            case 'q':{
-                 freeInocList(sys.inocHead);
-                 return 0;
+    while((buf = nextLine(&input)) != NULL){
+        /* Lines of sessions may leave nothing to run */
+        if((buf = sessionLine(sys, buf)) == NULL){
+            if(!pipelined){
+                outFlush(&sys->out);
             }
-            case 'c': createBatch(&sys, buf); break;
-            case 'l': listVaccines(&sys, buf); break;
-            case 'a': applyVaccine(&sys, buf); break;
-            case 'r': deleteVaccines(&sys, buf); break;
-            case 'd': deleteHistory(&sys, buf); break;
-            case 'u': listClientHistory(&sys, buf); break;
-            case 't': timeControl(&sys, buf); break;
+            continue;
+        }
+        if(buf[0] == 'q'){
+            break;
+        }
+        /* Journaled before it runs, since running tokenizes the line */
+        logCommand(&sys->journal, buf);
+        runCommand(sys, buf);
+        stepScans(sys);
+        /* Pipelined, results only go out when the buffer fills */
+        if(!pipelined){
+            outFlush(&sys->out);
         }
     }
+    finishScans(sys, NULL, 0);
+    sys->out.tag = NULL;
      
-    freeInocList(sys.inocHead);
+    if(input.nomem){
+        outError(&sys->out, sys->state, PTENOMEMORY, ENGENOMEMORY);
+    }
+#ifdef STATS
+    if(sys->stats.atQuit){
+        printStats(sys, "x");
+    }
+#endif
+    outFlush(&sys->out);
+    closeInput(&input);
+    freeSys(sys);
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,208 @@
+/**
+ * @file nameindex.c
+ * @brief Index of vaccine batches grouped by vaccine name.
+ *
+ * Each vaccine name is interned, and its id maps to the ids of its
+ * batches, kept in the same (expiry, batch) order as Sys::order, together
+ * with the position of the first batch that can still be dispensed. Like
+ * the order, new batches first go into a sorted run at the end of the
+ * ids, merged in before anything reads them.
+ */
+
+#include "nameindex.h"
+#include "intern.h"
+#include "vaccine.h"
+#include "utils.h"
+
+/**
+  * @brief Looks up a vaccine name.
+  *
+  * @param idx Pointer to the index.
+  * @param name Vaccine name.
+  * @return The id of the name, or -1 if it was never registered.
+  */
+int findName(NameIndex *idx, const char *name){
+    return internFind(&idx->keys, name);
+}
+
+/**
+  * @brief Looks up a vaccine name, registering it if needed.
+  *
+  * @param idx Pointer to the index.
+  * @param arena Arena holding the names.
+  * @param name Vaccine name.
+  * @return The id of the name, or -1 if memory is exhausted.
+  */
+int addName(NameIndex *idx, Arena *arena, const char *name){
+    int id, cnt = idx->keys.cnt;
+    if(idx->keys.cnt == idx->cap){
+        int newCap = idx->cap ? idx->cap * 2 : 16;
+        NameEntry *list = realloc(idx->list, newCap * sizeof(NameEntry));
+        if(list == NULL){
+            return -1;
+        }
+        idx->list = list;
+        idx->cap = newCap;
+    }
+    id = internAdd(&idx->keys, arena, name);
+    if(idx->keys.cnt > cnt){
+        memset(&idx->list[id], 0, sizeof(NameEntry));
+    }
+    return id;
+}
+
+/**
+  * @brief Makes room for one more batch id in an entry.
+  *
+  * @param e Pointer to the entry.
+  * @return 1 on success, 0 if memory is exhausted.
+  */
+int reserveNameBatch(NameEntry *e){
+    if(e->cnt == e->cap){
+        int newCap = e->cap ? e->cap * 2 : 4;
+        int *ids = realloc(e->ids, newCap * sizeof(int));
+        if(ids == NULL){
+            return 0;
+        }
+        e->ids = ids;
+        e->cap = newCap;
+    }
+    return 1;
+}
+
+/**
+  * @brief Finds the position of a batch within a sorted part of an entry.
+  *
+  * @param sys Pointer to the system.
+  * @param e Pointer to the entry.
+  * @param lo First position searched.
+  * @param hi Position after the last one searched.
+  * @param vacc Batch to locate.
+  * @return Index of the first id whose batch does not come before vacc.
+  */
+static int findNameBatchPos(Sys *sys, NameEntry *e, int lo, int hi,
+    const Vaccine *vacc){
+    while(lo < hi){
+        int mid = lo + (hi - lo) / 2;
+        if(compareBatches(&sys->store[e->ids[mid]], vacc) < 0){
+            lo = mid + 1;
+        }else{
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/**
+  * @brief Merges the run of new batches at the end of an entry into it.
+  *
+  * Merged from the back as in mergeOrder(), with the run held on the free
+  * id stack of the system. The stock position moves past the new batches
+  * placed before it, or back to the first of them that can be dispensed.
+  *
+  * @param sys Pointer to the system.
+  * @param e Pointer to the entry.
+  */
+void mergeNameBatches(Sys *sys, NameEntry *e){
+    int *run = sys->freeIds + sys->cntFree;
+    int end = e->sorted, j = e->cnt - e->sorted - 1;
+    int shifted = e->next, first = -1;
+    if(j < 0){
+        return;
+    }
+    memcpy(run, &e->ids[end], (j + 1) * sizeof(int));
+    for(; j >= 0; j--){
+        Vaccine *v = &sys->store[run[j]];
+        int p = findNameBatchPos(sys, e, 0, end, v);
+        memmove(&e->ids[p + j + 1], &e->ids[p], (end - p) * sizeof(int));
+        e->ids[p + j] = run[j];
+        end = p;
+        if(p <= e->next){
+            shifted++;
+            /* The last one found comes first in the merged entry */
+            if(v->doses > 0 && compareDates(v->expir, sys->tcurr) >= 0){
+                first = p + j;
+            }
+        }
+    }
+    e->next = first != -1 ? first : shifted;
+    e->sorted = e->cnt;
+}
+
+/**
+  * @brief Adds a batch, already present in sys->store, to its entry.
+  *
+  * reserveNameBatch() must have been called first. The batch joins the
+  * run of new batches, which is merged in once it holds about the square
+  * root of the entry, as in the order.
+  *
+  * @param sys Pointer to the system.
+  * @param e Pointer to the entry.
+  * @param id Id of the new batch.
+  */
+void insertNameBatch(Sys *sys, NameEntry *e, int id){
+    int run = e->cnt - e->sorted, p;
+    if(run >= ORDERRUN && (long)run * run >= e->cnt){
+        mergeNameBatches(sys, e);
+    }
+    p = findNameBatchPos(sys, e, e->sorted, e->cnt, &sys->store[id]);
+    memmove(&e->ids[p + 1], &e->ids[p], (e->cnt - p) * sizeof(int));
+    e->ids[p] = id;
+    e->cnt++;
+}
+
+/**
+  * @brief Removes a batch, still present in sys->store, from its entry.
+  *
+  * @param sys Pointer to the system.
+  * @param e Pointer to the entry.
+  * @param id Id of the batch to remove.
+  */
+void removeNameBatch(Sys *sys, NameEntry *e, int id){
+    int p;
+    mergeNameBatches(sys, e);
+    p = findNameBatchPos(sys, e, 0, e->cnt, &sys->store[id]);
+    memmove(&e->ids[p], &e->ids[p + 1], (e->cnt - p - 1) * sizeof(int));
+    e->sorted = --e->cnt;
+    if(p < e->next){
+        e->next--;
+    }else if(p == e->next){
+        advanceStock(sys, e);
+    }
+}
+
+/**
+  * @brief Moves the stock position past batches that cannot be dispensed.
+  *
+  * A batch cannot be dispensed once it ran out of doses or expired.
+  * Expired batches come first in every entry, as they do in sys->order.
+  *
+  * @param sys Pointer to the system.
+  * @param e Pointer to the entry.
+  */
+void advanceStock(Sys *sys, NameEntry *e){
+    mergeNameBatches(sys, e);
+    while(e->next < e->cnt){
+        Vaccine *v = &sys->store[e->ids[e->next]];
+        if(v->doses > 0 && compareDates(v->expir, sys->tcurr) >= 0){
+            break;
+        }
+        e->next++;
+    }
+}
+
+/**
+  * @brief Frees all memory used by the index.
+  *
+  * @param idx Pointer to the index.
+  */
+void freeNameIndex(NameIndex *idx){
+    int i;
+    for(i = 0; i < idx->keys.cnt; i++){
+        free(idx->list[i].ids);
+    }
+    free(idx->list);
+    idx->list = NULL;
+    idx->cap = 0;
+    freeIntern(&idx->keys);
+}
@@ -0,0 +1,17 @@
+#ifndef NAMEINDEX_H
+#define NAMEINDEX_H
+
+#include "project.h"
+
+
+/* Function prototypes related to the vaccine name index */
+int findName(NameIndex *idx, const char *name);
+int addName(NameIndex *idx, Arena *arena, const char *name);
+int reserveNameBatch(NameEntry *e);
+void mergeNameBatches(Sys *sys, NameEntry *e);
+void insertNameBatch(Sys *sys, NameEntry *e, int id);
+void removeNameBatch(Sys *sys, NameEntry *e, int id);
+void advanceStock(Sys *sys, NameEntry *e);
+void freeNameIndex(NameIndex *idx);
+
+#endif /* NAMEINDEX_H */
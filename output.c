@@ -0,0 +1,241 @@
+/**
+ * @file output.c
+ * @brief Buffered output with hand-written number and date formatting.
+ *
+ * Command results are appended to one reusable buffer and written out in
+ * a single call when the buffer fills up or at a command boundary, which
+ * avoids format-string parsing and per-call locking in stdio.
+ */
+
+#include "output.h"
+#include "stats.h"
+
+/**
+  * @brief Writes bytes to the destination stream.
+  *
+  * An output without a stream discards everything, which is how the
+  * results of replayed commands are kept off the screen.
+  *
+  * @param out Pointer to the output.
+  * @param p Bytes.
+  * @param n Number of bytes.
+  */
+static void writeOut(Output *out, const char *p, int n){
+    if(out->fp != NULL){
+        fwrite(p, 1, n, out->fp);
+    }
+}
+
+/**
+  * @brief Writes out everything waiting in the buffer.
+  *
+  * @param out Pointer to the output.
+  */
+void outFlush(Output *out){
+    if(out->len > 0){
+        writeOut(out, out->buf, out->len);
+        out->len = 0;
+    }
+    if(out->fp != NULL){
+        fflush(out->fp);
+    }
+}
+
+/**
+  * @brief Appends one character, without a session tag.
+  *
+  * @param out Pointer to the output.
+  * @param c Character.
+  */
+static void putChar(Output *out, char c){
+    if(out->len == OUTBUF){
+        writeOut(out, out->buf, out->len);
+        out->len = 0;
+    }
+    out->buf[out->len++] = c;
+}
+
+/**
+  * @brief Appends bytes, without a session tag.
+  *
+  * @param out Pointer to the output.
+  * @param s Bytes.
+  * @param n Number of bytes.
+  */
+static void putBytes(Output *out, const char *s, int n){
+    if(out->len + n > OUTBUF){
+        writeOut(out, out->buf, out->len);
+        out->len = 0;
+        if(n > OUTBUF){
+            writeOut(out, s, n);
+            return;
+        }
+    }
+    memcpy(out->buf + out->len, s, n);
+    out->len += n;
+}
+
+/**
+  * @brief Appends one character.
+  *
+  * In a session, every line starts with the session tag, so that a front
+  * end multiplexing many terminals can route it back.
+  *
+  * @param out Pointer to the output.
+  * @param c Character.
+  */
+void outChar(Output *out, char c){
+    if(out->tag != NULL){
+        if(!out->midLine){
+            putBytes(out, out->tag, out->tagLen);
+            putChar(out, ' ');
+        }
+        out->midLine = c != '\n';
+    }
+    putChar(out, c);
+}
+
+/**
+  * @brief Appends a string.
+  *
+  * @param out Pointer to the output.
+  * @param s String.
+  */
+void outStr(Output *out, const char *s){
+    if(out->tag != NULL){
+        while(*s != '\0'){
+            outChar(out, *s++);
+        }
+        return;
+    }
+    putBytes(out, s, (int)strlen(s));
+}
+
+/**
+  * @brief Appends a string followed by a newline, like puts().
+  *
+  * @param out Pointer to the output.
+  * @param s String.
+  */
+void outLine(Output *out, const char *s){
+    outStr(out, s);
+    outChar(out, '\n');
+}
+
+/**
+  * @brief Appends an integer in decimal, padded to at least a number of
+  * digits with leading zeros.
+  *
+  * @param out Pointer to the output.
+  * @param v Number.
+  * @param width Minimum number of digits.
+  */
+static void outPadded(Output *out, long v, int width){
+    char digits[24];
+    int n = 0;
+    unsigned long u = v < 0 ? -(unsigned long)v : (unsigned long)v;
+    do{
+        digits[n++] = (char)('0' + u % 10);
+        u /= 10;
+    }while(u > 0);
+    while(n < width){
+        digits[n++] = '0';
+    }
+    if(v < 0){
+        outChar(out, '-');
+    }
+    while(n > 0){
+        outChar(out, digits[--n]);
+    }
+}
+
+/**
+  * @brief Appends an integer in decimal, like "%d".
+  *
+  * @param out Pointer to the output.
+  * @param v Number.
+  */
+void outInt(Output *out, long v){
+    outPadded(out, v, 1);
+}
+
+/**
+  * @brief Appends a date as day-month-year, like "%.2d-%.2d-%d".
+  *
+  * @param out Pointer to the output.
+  * @param date Date.
+  */
+void outDate(Output *out, Date date){
+    outPadded(out, date.day, 2);
+    outChar(out, '-');
+    outPadded(out, date.month, 2);
+    outChar(out, '-');
+    outPadded(out, date.year, 1);
+}
+
+/**
+  * @brief Appends a batch identifier, unpacking it from its key.
+  *
+  * @param out Pointer to the output.
+  * @param key Packed batch identifier.
+  */
+void outBatch(Output *out, BatchKey key){
+    static const char digits[] = "0123456789ABCDEF";
+    int i;
+    for(i = 0; i < MAXSIZEBATCH - 1; i++){
+        unsigned long long w = i < KEYHIDIGITS ? key.hi : key.lo;
+        int shift = 59 - 5 * (i < KEYHIDIGITS ? i : i - KEYHIDIGITS);
+        int v = (int)(w >> shift & 31);
+        if(v == 0){
+            return;
+        }
+        outChar(out, digits[v - 1]);
+    }
+}
+
+/**
+  * @brief Appends an error message in the current language.
+  *
+  * @param out Pointer to the output.
+  * @param state Language state (ENG or PT).
+  * @param pt Message in Portuguese.
+  * @param eng Message in English.
+  */
+void outError(Output *out, int state, const char *pt, const char *eng){
+#ifdef STATS
+    countError(out, eng);
+#endif
+    outLine(out, state == PT ? pt : eng);
+}
+
+/**
+  * @brief Selects the session of a command line.
+  *
+  * A line "@<tag> <command>" runs the command for session <tag>, and every
+  * line of its result is written as "@<tag> <line>". Any other line runs
+  * outside of sessions and its result is written as is.
+  *
+  * @param out Pointer to the output.
+  * @param line Command line; the tag is null-terminated in place.
+  * @return The command without the tag.
+  */
+char *outSession(Output *out, char *line){
+    char *p = line;
+    out->midLine = 0;
+    if(*line != '@'){
+        out->tag = NULL;
+        return line;
+    }
+    while(*p != '\0' && !isspace((unsigned char)*p)){
+        p++;
+    }
+    out->tag = line;
+    out->tagLen = (int)(p - line);
+    if(*p != '\0'){
+        *p++ = '\0';
+    }
+    while(isspace((unsigned char)*p)){
+        p++;
+    }
+    return p;
+}
@@ -0,0 +1,18 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include "project.h"
+
+
+/* Function prototypes related to buffered output */
+void outFlush(Output *out);
+void outChar(Output *out, char c);
+void outStr(Output *out, const char *s);
+void outLine(Output *out, const char *s);
+void outInt(Output *out, long v);
+void outDate(Output *out, Date date);
+void outBatch(Output *out, BatchKey key);
+void outError(Output *out, int state, const char *pt, const char *eng);
+char *outSession(Output *out, char *line);
+
+#endif /* OUTPUT_H */
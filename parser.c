@@ -0,0 +1,176 @@
+/**
+ * @file parser.c
+ * @brief In-place tokenizer shared by all commands.
+ *
+ * Tokens are returned as views into the input line, which is modified
+ * only to terminate each token, so parsing a command allocates nothing
+ * and copies nothing.
+ */
+
+#include "parser.h"
+
+/**
+  * @brief Reads the next whitespace-separated token.
+  *
+  * @param cur Pointer to the current position in the line; advanced past
+  *            the token.
+  * @param tok Filled with the token.
+  * @return 1 if a token was read, 0 if the line has no more tokens.
+  */
+int nextToken(char **cur, Token *tok){
+    char *p = *cur;
+    while(*p && isspace((unsigned char)*p)){
+        p++;
+    }
+    if(*p == '\0'){
+        *cur = p;
+        return 0;
+    }
+    tok->s = p;
+    while(*p && !isspace((unsigned char)*p)){
+        p++;
+    }
+    tok->len = (int)(p - tok->s);
+    if(*p){
+        *p++ = '\0';
+    }
+    *cur = p;
+    return 1;
+}
+
+/**
+  * @brief Reads the next user name, which may be enclosed in quotes.
+  *
+  * A quoted name may contain spaces and tabs and ends at the closing
+  * quote. If that quote is missing, tok is left pointing at the text
+  * after the opening quote.
+  *
+  * @param cur Pointer to the current position in the line; advanced past
+  *            the name.
+  * @param tok Filled with the name, without quotes.
+  * @return 1 if a name was read, 0 if there is none, -1 if the closing
+  *         quote is missing.
+  */
+int nextName(char **cur, Token *tok){
+    char *p = *cur, *end;
+    while(*p && isspace((unsigned char)*p)){
+        p++;
+    }
+    if(*p != '"'){
+        *cur = p;
+        return nextToken(cur, tok);
+    }
+    tok->s = ++p;
+    end = strchr(p, '"');
+    if(end == NULL){
+        tok->len = (int)strlen(p);
+        *cur = p + tok->len;
+        return -1;
+    }
+    *end = '\0';
+    tok->len = (int)(end - p);
+    *cur = end + 1;
+    return 1;
+}
+
+/**
+  * @brief Parses decimal digits at the start of a string.
+  *
+  * @param s Pointer to the string; advanced past the digits.
+  * @param value Filled with the number.
+  * @return 1 if at least one digit was read without overflow, 0 otherwise.
+  */
+static int parseDigits(char **s, int *value){
+    char *p = *s;
+    int v = 0;
+    if(!isdigit((unsigned char)*p)){
+        return 0;
+    }
+    while(isdigit((unsigned char)*p)){
+        int d = *p - '0';
+        if(v > (2147483647 - d) / 10){
+            return 0;
+        }
+        v = v * 10 + d;
+        p++;
+    }
+    *s = p;
+    *value = v;
+    return 1;
+}
+
+/**
+  * @brief Parses a token as a decimal integer, with an optional sign.
+  *
+  * @param tok Token to parse.
+  * @param value Filled with the number.
+  * @return 1 if the whole token is a valid integer, 0 otherwise.
+  */
+int parseInt(Token *tok, int *value){
+    char *p = tok->s;
+    int neg = 0;
+    if(*p == '-' || *p == '+'){
+        neg = *p == '-';
+        p++;
+    }
+    if(!parseDigits(&p, value) || *p != '\0'){
+        return 0;
+    }
+    if(neg){
+        *value = -*value;
+    }
+    return 1;
+}
+
+/**
+  * @brief Parses a token as a batch identifier.
+  *
+  * A batch identifier has 1 to 20 digits among 0-9 and A-F.
+  *
+  * @param tok Token to parse.
+  * @param key Filled with the packed identifier.
+  * @return 1 if the token is a valid batch identifier, 0 otherwise.
+  */
+int parseBatch(Token *tok, BatchKey *key){
+    int i;
+    key->hi = key->lo = 0;
+    if(tok->len == 0 || tok->len >= MAXSIZEBATCH){
+        return 0;
+    }
+    for(i = 0; i < tok->len; i++){
+        char c = tok->s[i];
+        unsigned long long v;
+        if(c >= '0' && c <= '9'){
+            v = (unsigned long long)(c - '0' + 1);
+        }else if(c >= 'A' && c <= 'F'){
+            v = (unsigned long long)(c - 'A' + 11);
+        }else{
+            return 0;
+        }
+        if(i < KEYHIDIGITS){
+            key->hi |= v << (59 - 5 * i);
+        }else{
+            key->lo |= v << (59 - 5 * (i - KEYHIDIGITS));
+        }
+    }
+    return 1;
+}
+
+/**
+  * @brief Parses a token in the form day-month-year.
+  *
+  * Only the syntax is checked; use verifyDate() for the calendar.
+  *
+  * @param tok Token to parse.
+  * @param date Filled with the date.
+  * @return 1 if the whole token is a date, 0 otherwise.
+  */
+int parseDate(Token *tok, Date *date){
+    char *p = tok->s;
+    if(!parseDigits(&p, &date->day) || *p++ != '-' ||
+        !parseDigits(&p, &date->month) || *p++ != '-' ||
+        !parseDigits(&p, &date->year) || *p != '\0'){
+        return 0;
+    }
+    return 1;
+}
@@ -0,0 +1,14 @@
+#ifndef PARSER_H
+#define PARSER_H
+
+#include "project.h"
+
+
+/* Function prototypes related to command parsing */
+int nextToken(char **cur, Token *tok);
+int nextName(char **cur, Token *tok);
+int parseInt(Token *tok, int *value);
+int parseDate(Token *tok, Date *date);
+int parseBatch(Token *tok, BatchKey *key);
+
+#endif /* PARSER_H */
@@ -9,8 +9,23 @@
 /* Constants definitions */
 #define MAXNAMEVACC 51       /**< Maximum length of vaccine name in bytes */
 #define MAXSIZEBATCH 21         /**< Maximum length of batch (lote) string */
-#define MAXBATCHES 1000          /**< Maximum number of vaccine batches */
-#define BUFMAX 65536           /**< Maximum input line length */
+#define KEYHIDIGITS 12          /**< Batch digits packed in BatchKey::hi */
+#define MAXBATCHES 1000          /**< Default limit on vaccine batches */
+#define MAXYEAR 4194303          /**< Largest year packDate() can hold */
+#define INCHUNK 1048576        /**< Size of the stdin read buffer */
+#define LINEINIT 4096          /**< Initial size of the line buffer */
+#define ARENACHUNK 65536       /**< Default size of an arena chunk */
+#define OUTBUF 65536           /**< Size of the output buffer */
+#define SNAPMAGIC "VACCSNAP"   /**< First bytes of a snapshot file */
+#define SNAPVERSION 7          /**< Version of the snapshot layout */
+#define FNVSEED 2166136261UL   /**< Starting value of a checksum */
+#define NERRMSG 16             /**< Number of distinct error messages */
+#define LATSUB 8               /**< Latency buckets per power of two */
+#define LATBUCKETS 320         /**< Buckets of a latency histogram */
+#define COMPACTPCT 25          /**< Default dead percentage that compacts */
+#define COMPACTMIN 64          /**< Fewest dead entries worth compacting */
+#define ORDERRUN 64            /**< Fewest new batches worth merging */
+#define SCANCHUNK 256          /**< Lines a deferred listing prints per step */
  
 /* Error messages in Portuguese */
 #define PTE2MANYVAC "demasiadas vacinas"        /**< Too many vaccines */
@@ -25,6 +40,10 @@
 #define PTENOBATCH "lote inexistente"           /**< No such batch */
 #define PTENOUSER "utente inexistente"          /**< No such user */
 #define PTENOMEMORY "sem memória"               /**< Out of memory */
+#define PTENOSAVE "impossível gravar"           /**< Cannot save snapshot */
+#define PTEBADSNAP "snapshot inválido"          /**< Unreadable snapshot */
+#define PTEBADJOURNAL "diário inválido"         /**< Unusable journal */
+#define PTELOSTJOURNAL "diário perdido"         /**< Journal not restarted */
  
 /* Error messages in English */
 #define ENGE2MANYVAC "too many vaccines"
@@ -39,6 +58,10 @@
 #define ENGENOBATCH "no such batch"
 #define ENGENOUSER "no such user"
 #define ENGENOMEMORY "memory exausted"
+#define ENGENOSAVE "cannot save"
+#define ENGEBADSNAP "invalid snapshot"
+#define ENGEBADJOURNAL "invalid journal"
+#define ENGELOSTJOURNAL "journal lost"
  
 #define ENG 1
 #define PT 0
@@ -52,45 +75,284 @@ typedef struct date{
     int year;
 }Date;
  
+/**
+  * @brief View of a token inside the input line.
+  *
+  * The tokenizer terminates tokens in place, so s is also a valid
+  * null-terminated string of length len.
+  */
+typedef struct token{
+    char *s;                 /**< First character of the token */
+    int len;                 /**< Length of the token */
+}Token;
+ 
+/**
+  * @brief Batch identifier packed into two integers.
+  *
+  * Each of the up to 20 hexadecimal digits takes 5 bits, holding its
+  * value plus one, from the most significant bit down; unused digits are
+  * zero. Comparing (hi, lo) as integers therefore orders keys exactly as
+  * strcmp() orders the identifiers.
+  */
+typedef struct batchKey{
+    unsigned long long hi;    /**< Digits 0 to 11 */
+    unsigned long long lo;    /**< Digits 12 to 19 */
+}BatchKey;
+ 
 /**
   * @brief Represents a vaccine batch.
   */
 typedef struct vaccine{
     char name[MAXNAMEVACC];   /**< Vaccine name */
-    char batch[MAXSIZEBATCH];     /**< Batch identifier */
+    BatchKey key;             /**< Batch identifier */
     Date expir;              /**< Expiration date */
     int doses;                /**< Available doses */
     int applys;           /**< Number of inoculations made */
+    int id;               /**< Stable identifier, independent of position */
+    int dead;             /**< 1 once removed, until the order is compacted */
+    int nameId;           /**< Id of the name in the name index */
 }Vaccine;
  
- /**
-  * @brief Represents a vaccine inoculation.
+/**
+  * @brief Running totals of doses and inoculations.
+  *
+  * Kept up to date by the commands that change them, so that the 's'
+  * command never has to scan. The count of today's inoculations is reset
+  * lazily, the first time it is touched on a new date.
+  */
+typedef struct tally{
+    long doses;               /**< Doses left in batches not expired */
+    long applys;              /**< Inoculations not deleted */
+    long today;               /**< Inoculations not deleted made on day */
+    int day;                  /**< Packed date that today counts */
+}Tally;
+ 
+/**
+  * @brief Batches of one vaccine, in the same order as Sys::order.
+  */
+typedef struct nameEntry{
+    int *ids;                 /**< Batch ids ordered by expiry and batch */
+    int cnt;                  /**< Number of batch ids */
+    int sorted;               /**< Leading ids merged in order */
+    int cap;                  /**< Allocated size of ids */
+    int next;                 /**< Index in ids of the first batch in stock */
+    Tally tally;              /**< Totals of this vaccine */
+}NameEntry;
+ 
+/**
+  * @brief Table of interned strings, each identified by a small integer.
+  *
+  * Ids are handed out densely from 0 and never change.
+  */
+typedef struct intern{
+    int *tab;                 /**< Open addressing slots, -1 if empty */
+    int size;                 /**< Number of slots (power of two) */
+    char **strs;              /**< String of each id */
+    int cnt;                  /**< Number of ids handed out */
+    int cap;                  /**< Allocated size of strs */
+}Intern;
+ 
+/**
+  * @brief Vaccine names and the batches of each one.
+  */
+typedef struct nameIndex{
+    Intern keys;              /**< Vaccine names */
+    NameEntry *list;          /**< Entry of each name id */
+    int cap;                  /**< Allocated size of list */
+}NameIndex;
+ 
+/**
+  * @brief Block of memory handed out by an arena.
+  */
+typedef struct arenaChunk{
+    struct arenaChunk *next;  /**< Previously filled chunk */
+    size_t used;              /**< Bytes already handed out */
+    size_t size;              /**< Bytes available in data */
+    char data[];              /**< Storage */
+}ArenaChunk;
+ 
+/**
+  * @brief Bump allocator released all at once.
+  */
+typedef struct arena{
+    ArenaChunk *head;         /**< Chunk currently being filled */
+    long mallocs;             /**< Number of malloc calls made so far */
+    size_t bytes;             /**< Total bytes obtained from malloc */
+}Arena;
+ 
+/**
+  * @brief Open addressing hash table from batch identifier to batch id.
+  */
+typedef struct batchIndex{
+    int *tab;                 /**< Batch ids, -1 for empty slots */
+    int size;                 /**< Number of slots (power of two) */
+    int used;                 /**< Number of occupied slots */
+}BatchIndex;
+ 
+/**
+  * @brief Inoculation records, stored column by column.
+  *
+  * Record i is made of user[i], batch[i], vType[i] and date[i]. Records
+  * are appended in order of application and deleted records are only
+  * cleared in the live bitmap, so indices only change when the deleted
+  * records are compacted away.
+  */
+typedef struct history{
+    int *user;               /**< Id of the user in the user index */
+    int *batch;              /**< Id of the batch used */
+    int *vType;              /**< Id of the vaccine name in the name index */
+    int *date;               /**< Packed date of inoculation */
+    int *nextUser;           /**< Next record of the same user, or -1 */
+    unsigned char *live;     /**< Bit i set while record i is not deleted */
+    int cnt;                 /**< Number of records, deleted ones included */
+    int dead;                /**< Number of deleted records */
+    int cap;                 /**< Allocated size of the columns */
+}History;
+ 
+/**
+  * @brief Inoculations of one user, in order of application.
+  */
+typedef struct userEntry{
+    int first;                /**< First live record of the user, or -1 */
+    int last;                 /**< Last live record of the user, or -1 */
+}UserEntry;
+ 
+/**
+  * @brief User names and the inoculations of each one.
+  */
+typedef struct userIndex{
+    Intern keys;              /**< User names */
+    UserEntry *list;          /**< Entry of each user id */
+    int cap;                  /**< Allocated size of list */
+}UserIndex;
+ 
+/**
+  * @brief Hash set of the inoculations made on the current date.
+  *
+  * Keyed by (user, vaccine name); used for the "already vaccinated"
+  * rule, which only concerns the current date.
+  */
+typedef struct daySet{
+    int *tab;                 /**< Records of today, -1 if empty */
+    int size;                 /**< Number of slots (power of two) */
+    int used;                 /**< Number of occupied slots */
+}DaySet;
+ 
+/**
+  * @brief Source of command lines.
+  *
+  * A command file is read into buf as a whole and its lines are handed
+  * out in place; standard input is read line by line into buf, which
+  * grows to fit lines of any length.
+  */
+typedef struct input{
+    FILE *fp;                 /**< Stream being read */
+    char *buf;                /**< File contents or current line */
+    size_t cap;               /**< Allocated size of buf */
+    size_t len;               /**< Bytes of the file held in buf */
+    size_t pos;               /**< Start of the next line in buf */
+    int whole;                /**< 1 if buf holds the whole file */
+    int nomem;                /**< 1 if reading stopped for lack of memory */
+}Input;
+ 
+/**
+  * @brief Buffered writer for everything the commands print.
+  */
+typedef struct output{
+    FILE *fp;                 /**< Destination stream */
+    int len;                  /**< Bytes waiting in buf */
+    const char *tag;          /**< Session tag put before each line, or NULL */
+    int tagLen;               /**< Length of tag */
+    int midLine;              /**< 1 if the last byte written was not '\n' */
+#ifdef STATS
+    long errors[NERRMSG];     /**< Times each error message was printed */
+    long errorCnt;            /**< Error messages printed in total */
+#endif
+    char buf[OUTBUF];         /**< Pending output */
+}Output;
+ 
+#ifdef STATS
+/**
+  * @brief Counters of the commands run, only built with -DSTATS.
+  *
+  * Latencies are only recorded when a clock is provided, since the
+  * program itself has no access to one; the bench driver provides it.
+  */
+typedef struct stats{
+    long calls[26];           /**< Commands run, by command letter */
+    long errs[26];            /**< Error messages printed, by command */
+    long lat[26][LATBUCKETS]; /**< Latency histogram, by command */
+    long (*clock)(void);      /**< Nanosecond clock, or NULL */
+    int atQuit;               /**< 1 to print the counters when quitting */
+}Stats;
+#endif
+ 
+/**
+  * @brief Append-only log of the commands that change the system.
+  *
+  * Each record is the command line preceded by its length and followed
+  * by its checksum, so a record cut short by a crash is detected.
   */
-typedef struct inoculation{
-    char *userName;          /**< Name of the user (dynamically allocated) */
-    char batch[MAXSIZEBATCH];       /**< Batch identifier used */
-    char vType[MAXNAMEVACC];   /**< Name of the vaccine applied */
-    Date aplication;              /**< Date of inoculation */
-}Inoculation;
+typedef struct journal{
+    FILE *fp;                 /**< Journal being appended to, or NULL */
+    const char *path;         /**< Journal file */
+    int every;                /**< Records per flush (group commit) */
+    int pending;              /**< Records written since the last flush */
+}Journal;
  
 /**
-  * @brief Node for the linked list of inoculations.
+  * @brief Long 'u' or 'l' listing of a session, printed in steps.
+  *
+  * It prints what was there when it started: records from pos to end that
+  * were live then, or the batches with their counts at that time.
   */
-typedef struct inocNode{
-    Inoculation inoc;            /**< Inoculation record */
-    struct inocNode *next;      /**< Pointer to the next node */
-}InocNode;
+typedef struct scan{
+    char *tag;                /**< Session tag (not null-terminated) */
+    int tagLen;               /**< Length of tag */
+    char kind;                /**< 'u' or 'l' */
+    int pos;                  /**< Next record or row to print */
+    int end;                  /**< Records or rows in the view */
+    unsigned char *live;      /**< 'u': live bitmap of the first end records */
+    int *rows;                /**< 'l': id, doses and applys of each batch */
+    struct scan *next;        /**< Next pending listing, or NULL */
+}Scan;
  
 /**
   * @brief System structure containing vaccine batches and inoculations.
   */
 typedef struct sys{
     int cntV;                 /**< Count of vaccine batches */
-    Vaccine arr[MAXBATCHES];  /**< Array of vaccine batches */
-    InocNode *inocHead;       /**< Head of inoculations list */
-    InocNode *inocTail;       /**< Tail of inoculations list */
+    Vaccine *store;           /**< Batches, indexed by batch id */
+    int *order;               /**< Batch ids ordered by expiry and batch */
+    int cntOrder;             /**< Ids in order, removed batches included */
+    int cntSorted;            /**< Leading ids of order merged in order */
+    int cntDead;              /**< Removed batches still in order */
+    int capV;                 /**< Allocated size of store, order, freeIds */
+    int maxV;                 /**< Most batches allowed at the same time */
+    int gen;                  /**< Generation of the last snapshot saved */
+    History hist;             /**< Inoculation records */
     int state;               /**< Language state (ENG or PT) */
     Date tcurr;              /**< Current simulated date */
+    NameIndex names;         /**< Batches grouped by vaccine name */
+    BatchIndex batches;      /**< Batches by batch identifier */
+    UserIndex users;         /**< Inoculations grouped by user */
+    DaySet today;            /**< Inoculations made on tcurr */
+    Arena arena;             /**< Storage for interned names */
+    int *freeIds;            /**< Stack of unused batch ids */
+    int cntFree;             /**< Number of ids in freeIds */
+    int nextId;              /**< Lowest id never handed out */
+    int cntExpired;          /**< Leading batches of order already expired */
+    int compactPct;          /**< Dead percentage that triggers compaction */
+    long wastedDoses;        /**< Doses left in batches when they expired */
+    Tally tally;             /**< Totals of all vaccines */
+    int liveUsers;           /**< Users with an inoculation not deleted */
+    Output out;              /**< Where command results are written */
+    Journal journal;         /**< Log of the commands that changed sys */
+    Scan *scans;             /**< Pending listings, oldest first */
+    Intern closed;           /**< Tags of the sessions that quit */
+#ifdef STATS
+    Stats stats;             /**< Counters of the commands run */
+#endif
 }Sys;
 
 #endif /* PROJECT_H */
\ No newline at end of file
@@ -0,0 +1,205 @@
+/**
+ * @file scan.c
+ * @brief Long listings of a session, printed in steps against a view.
+ *
+ * A full 'l' listing, or a 'u' listing of all users, can be long enough
+ * to hold up every other session behind it. In a session, it takes a view
+ * of what it lists instead, and prints a chunk of it after each command;
+ * it is finished before the next command of its own session, so that
+ * session still sees its results in order. Records are only ever appended
+ * or flagged as deleted, so a copy of the live bitmap is a view of the
+ * history; the view of the batches copies the counts that commands
+ * change. Anything that renumbers records or frees batch ids finishes the
+ * pending listings first.
+ */
+
+#include "scan.h"
+#include "vaccine.h"
+#include "inoculations.h"
+
+/**
+  * @brief Frees a listing.
+  *
+  * @param s Pointer to the listing.
+  */
+static void freeScan(Scan *s){
+    free(s->tag);
+    free(s->live);
+    free(s->rows);
+    free(s);
+}
+
+/**
+  * @brief Takes the view of a 'u' listing: which of the records it
+  * covers are live.
+  *
+  * @param sys Pointer to the system.
+  * @param s Pointer to the listing, with the records to cover set.
+  * @return 1 on success, 0 if memory is exhausted.
+  */
+static int viewHistory(Sys *sys, Scan *s){
+    int n = (s->end + 7) / 8;
+    if((s->live = malloc(n + 1)) == NULL){
+        return 0;
+    }
+    if(n > 0){
+        memcpy(s->live, sys->hist.live, n);
+    }
+    return 1;
+}
+
+/**
+  * @brief Takes the view of a full 'l' listing: the batches in order,
+  * with their current counts.
+  *
+  * @param sys Pointer to the system.
+  * @param s Pointer to the listing.
+  * @return 1 on success, 0 if memory is exhausted.
+  */
+static int viewBatches(Sys *sys, Scan *s){
+    int i, k = 0;
+    if((s->rows = malloc((3 * sys->cntV + 1) * sizeof(int))) == NULL){
+        return 0;
+    }
+    for(i = 0; i < sys->cntOrder; i++){
+        Vaccine *v = &sys->store[sys->order[i]];
+        if(!v->dead){
+            s->rows[k++] = v->id;
+            s->rows[k++] = v->doses;
+            s->rows[k++] = v->applys;
+        }
+    }
+    s->end = k / 3;
+    return 1;
+}
+
+/**
+  * @brief Prints up to a number of lines of a listing, tagged with its
+  * session.
+  *
+  * @param sys Pointer to the system.
+  * @param s Pointer to the listing.
+  * @param lines Most lines to print.
+  * @return 1 if the listing is finished, 0 otherwise.
+  */
+static int runScan(Sys *sys, Scan *s, int lines){
+    Output *out = &sys->out;
+    const char *tag = out->tag;
+    int tagLen = out->tagLen, midLine = out->midLine;
+
+    out->tag = s->tag;
+    out->tagLen = s->tagLen;
+    out->midLine = 0;
+    if(s->kind == 'u'){
+        for(; s->pos < s->end && lines > 0; s->pos++){
+            if((s->live[s->pos / 8] >> (s->pos % 8)) & 1){
+                printInoculation(sys, s->pos);
+                lines--;
+            }
+        }
+    }else{
+        for(; s->pos < s->end && lines > 0; s->pos++, lines--){
+            int *row = &s->rows[3 * s->pos];
+            Vaccine v = sys->store[row[0]];
+            v.doses = row[1];
+            v.applys = row[2];
+            printBatch(sys, &v);
+        }
+    }
+    out->tag = tag;
+    out->tagLen = tagLen;
+    out->midLine = midLine;
+    return s->pos == s->end;
+}
+
+/**
+  * @brief Starts a long listing in steps, if the current command belongs
+  * to a session.
+  *
+  * @param sys Pointer to the system.
+  * @param kind 'u' or 'l'.
+  * @param pos First record of a 'u' listing (ignored for 'l').
+  * @param end Record after the last one of a 'u' listing (ignored for 'l').
+  * @return 1 if the listing was started, 0 if the caller should print it
+  * at once (outside of sessions, or if memory is exhausted).
+  */
+int startScan(Sys *sys, char kind, int pos, int end){
+    Scan *s, **tail = &sys->scans;
+    int ok;
+    if(sys->out.tag == NULL || (s = calloc(1, sizeof(Scan))) == NULL){
+        return 0;
+    }
+    s->kind = kind;
+    s->pos = pos;
+    s->end = end;
+    s->tagLen = sys->out.tagLen;
+    /* The tag lives in the input line, which is about to be reused */
+    if((s->tag = malloc(s->tagLen)) == NULL){
+        freeScan(s);
+        return 0;
+    }
+    memcpy(s->tag, sys->out.tag, s->tagLen);
+    ok = kind == 'u' ? viewHistory(sys, s) : viewBatches(sys, s);
+    if(!ok){
+        freeScan(s);
+        return 0;
+    }
+    while(*tail != NULL){
+        tail = &(*tail)->next;
+    }
+    *tail = s;
+    return 1;
+}
+
+/**
+  * @brief Prints the next chunk of every pending listing.
+  *
+  * @param sys Pointer to the system.
+  */
+void stepScans(Sys *sys){
+    Scan **p = &sys->scans;
+    while(*p != NULL){
+        Scan *s = *p;
+        if(runScan(sys, s, SCANCHUNK)){
+            *p = s->next;
+            freeScan(s);
+        }else{
+            p = &s->next;
+        }
+    }
+}
+
+/**
+  * @brief Prints the rest of the pending listings of a session.
+  *
+  * @param sys Pointer to the system.
+  * @param tag Session tag, or NULL for the listings of every session.
+  * @param tagLen Length of tag.
+  */
+void finishScans(Sys *sys, const char *tag, int tagLen){
+    Scan **p = &sys->scans;
+    while(*p != NULL){
+        Scan *s = *p;
+        if(tag == NULL || (s->tagLen == tagLen &&
+            memcmp(s->tag, tag, tagLen) == 0)){
+            runScan(sys, s, s->end);
+            *p = s->next;
+            freeScan(s);
+        }else{
+            p = &s->next;
+        }
+    }
+}
+
+/**
+  * @brief Frees the pending listings without printing them.
+  *
+  * @param sys Pointer to the system.
+  */
+void freeScans(Sys *sys){
+    while(sys->scans != NULL){
+        Scan *s = sys->scans;
+        sys->scans = s->next;
+        freeScan(s);
+    }
+}
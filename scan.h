@@ -0,0 +1,13 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include "project.h"
+
+
+/* Function prototypes related to listings printed in steps */
+int startScan(Sys *sys, char kind, int pos, int end);
+void stepScans(Sys *sys);
+void finishScans(Sys *sys, const char *tag, int tagLen);
+void freeScans(Sys *sys);
+
+#endif /* SCAN_H */
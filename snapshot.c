@@ -0,0 +1,431 @@
+/**
+ * @file snapshot.c
+ * @brief Binary snapshots of the whole system.
+ *
+ * A snapshot stores every array of the system exactly as it is in
+ * memory, one block after the other: the magic and version, the batches,
+ * the interned names and their tables, the history columns and the set
+ * of today's inoculations, followed by a checksum of all the blocks.
+ * Restoring is one allocation and one read per array, so it takes time
+ * proportional to the file size, with no per-record parsing or malloc.
+ * Snapshots are only meant to be read back on the machine that wrote
+ * them.
+ */
+
+#include "snapshot.h"
+#include "arena.h"
+#include "parser.h"
+#include "output.h"
+#include "utils.h"
+#include "journal.h"
+#include "vaccine.h"
+#include "nameindex.h"
+
+/**
+  * @brief Snapshot file being written or read.
+  */
+typedef struct snapFile{
+    FILE *fp;                 /**< Open file */
+    unsigned long sum;        /**< FNV-1a checksum of the blocks so far */
+    int err;                  /**< 1 once a read or write failed */
+}SnapFile;
+
+/**
+  * @brief Writes one block.
+  *
+  * @param f Pointer to the snapshot file.
+  * @param p Bytes.
+  * @param n Number of bytes.
+  */
+static void putBlock(SnapFile *f, const void *p, size_t n){
+    if(n > 0 && !f->err){
+        f->err = fwrite(p, 1, n, f->fp) != n;
+        f->sum = checksum(f->sum, p, n);
+    }
+}
+
+/**
+  * @brief Writes one int.
+  *
+  * @param f Pointer to the snapshot file.
+  * @param v Value.
+  */
+static void putInt(SnapFile *f, int v){
+    putBlock(f, &v, sizeof(int));
+}
+
+/**
+  * @brief Reads one block.
+  *
+  * @param f Pointer to the snapshot file.
+  * @param p Destination.
+  * @param n Number of bytes.
+  */
+static void getBlock(SnapFile *f, void *p, size_t n){
+    if(n > 0 && !f->err){
+        f->err = fread(p, 1, n, f->fp) != n;
+        f->sum = checksum(f->sum, p, n);
+    }
+}
+
+/**
+  * @brief Reads one int, which must lie in [lo, hi].
+  *
+  * @param f Pointer to the snapshot file.
+  * @param lo Smallest accepted value.
+  * @param hi Largest accepted value.
+  * @return The value, or lo if it could not be read or is out of range.
+  */
+static int getInt(SnapFile *f, int lo, int hi){
+    int v = lo;
+    getBlock(f, &v, sizeof(int));
+    if(v < lo || v > hi){
+        f->err = 1;
+        v = lo;
+    }
+    return v;
+}
+
+/**
+  * @brief Allocates an array for a block that is about to be read.
+  *
+  * @param f Pointer to the snapshot file.
+  * @param n Number of bytes (at least one is allocated).
+  * @return The array, or NULL (with the error flag set) on failure.
+  */
+static void *getArray(SnapFile *f, size_t n){
+    void *p = f->err ? NULL : malloc(n > 0 ? n : 1);
+    if(p == NULL){
+        f->err = 1;
+    }
+    return p;
+}
+
+/**
+  * @brief Returns the smallest power of two, at least min, that holds n.
+  *
+  * @param n Number of elements.
+  * @param min Smallest capacity.
+  * @return The capacity.
+  */
+static int capFor(int n, int min){
+    int cap = min;
+    while(cap < n){
+        cap *= 2;
+    }
+    return cap;
+}
+
+/**
+  * @brief Writes an intern table: its slots, then all strings in one blob.
+  *
+  * @param f Pointer to the snapshot file.
+  * @param t Pointer to the table.
+  */
+static void putIntern(SnapFile *f, Intern *t){
+    int i, off = 0;
+    putInt(f, t->cnt);
+    putInt(f, t->size);
+    putBlock(f, t->tab, t->size * sizeof(int));
+    for(i = 0; i < t->cnt; i++){
+        putInt(f, off);
+        off += (int)strlen(t->strs[i]) + 1;
+    }
+    putInt(f, off);
+    for(i = 0; i < t->cnt; i++){
+        putBlock(f, t->strs[i], strlen(t->strs[i]) + 1);
+    }
+}
+
+/**
+  * @brief Reads an intern table written by putIntern().
+  *
+  * The strings are read in one block into the arena.
+  *
+  * @param f Pointer to the snapshot file.
+  * @param t Pointer to the (empty) table.
+  * @param arena Arena that will hold the strings.
+  */
+static void getIntern(SnapFile *f, Intern *t, Arena *arena){
+    int i, len;
+    char *blob;
+    t->cnt = getInt(f, 0, 0x3FFFFFFF);
+    t->size = getInt(f, 0, 0x3FFFFFFF);
+    t->cap = capFor(t->cnt, 16);
+    if((t->size & (t->size - 1)) != 0 || t->size < 2 * t->cnt){
+        f->err = 1;
+    }
+    t->tab = getArray(f, t->size * sizeof(int));
+    getBlock(f, t->tab, t->size * sizeof(int));
+    t->strs = getArray(f, t->cap * sizeof(char *));
+    for(i = 0; i < t->cnt && !f->err; i++){
+        t->strs[i] = (char *)(size_t)getInt(f, 0, 0x7FFFFFFF);
+    }
+    len = getInt(f, 0, 0x7FFFFFFF);
+    blob = f->err ? NULL : arenaAlloc(arena, len > 0 ? len : 1);
+    if(blob == NULL){
+        f->err = 1;
+        t->cnt = 0;
+        return;
+    }
+    getBlock(f, blob, len);
+    for(i = 0; i < t->cnt; i++){
+        size_t off = (size_t)t->strs[i];
+        if(off >= (size_t)len || blob[len - 1] != '\0'){
+            f->err = 1;
+            off = 0;
+            blob[0] = '\0';
+        }
+        t->strs[i] = blob + off;
+    }
+}
+
+/**
+  * @brief Writes the system to a snapshot file.
+  *
+  * The file is written under a temporary name and then renamed, so an
+  * existing snapshot is only replaced by a complete one. It is stamped
+  * with the generation after the system's. New batches are merged into
+  * the order first, so a snapshot always holds it whole.
+  *
+  * @param sys Pointer to the system.
+  * @param path Snapshot file.
+  * @return 1 on success, 0 otherwise.
+  */
+int writeSnapshot(Sys *sys, const char *path){
+    SnapFile f = {NULL, FNVSEED, 0};
+    History *h = &sys->hist;
+    char *tmp = malloc(strlen(path) + 5);
+    unsigned int sum;
+    int i;
+ 
+    if(tmp == NULL){
+        return 0;
+    }
+    strcpy(tmp, path);
+    strcat(tmp, ".tmp");
+    mergeOrder(sys);
+    f.fp = fopen(tmp, "wb");
+    if(f.fp == NULL){
+        free(tmp);
+        return 0;
+    }
+ 
+    putBlock(&f, SNAPMAGIC, 8);
+    putInt(&f, SNAPVERSION);
+    putInt(&f, sys->state);
+    putInt(&f, sys->maxV);
+    putInt(&f, sys->gen + 1);
+    putBlock(&f, &sys->tcurr, sizeof(Date));
+    putBlock(&f, &sys->wastedDoses, sizeof(long));
+    putBlock(&f, &sys->tally, sizeof(Tally));
+    putInt(&f, sys->liveUsers);
+ 
+    putInt(&f, sys->cntV);
+    putInt(&f, sys->cntOrder);
+    putInt(&f, sys->cntDead);
+    putInt(&f, sys->nextId);
+    putInt(&f, sys->cntFree);
+    putInt(&f, sys->cntExpired);
+    putBlock(&f, sys->store, sys->nextId * sizeof(Vaccine));
+    putBlock(&f, sys->order, sys->cntOrder * sizeof(int));
+    putBlock(&f, sys->freeIds, sys->cntFree * sizeof(int));
+    putInt(&f, sys->batches.size);
+    putInt(&f, sys->batches.used);
+    putBlock(&f, sys->batches.tab, sys->batches.size * sizeof(int));
+ 
+    putIntern(&f, &sys->names.keys);
+    for(i = 0; i < sys->names.keys.cnt; i++){
+        NameEntry *e = &sys->names.list[i];
+        mergeNameBatches(sys, e);
+        putInt(&f, e->cnt);
+        putInt(&f, e->next);
+        putBlock(&f, &e->tally, sizeof(Tally));
+        putBlock(&f, e->ids, e->cnt * sizeof(int));
+    }
+ 
+    putIntern(&f, &sys->users.keys);
+    putBlock(&f, sys->users.list, sys->users.keys.cnt * sizeof(UserEntry));
+ 
+    putInt(&f, h->cnt);
+    putInt(&f, h->dead);
+    putBlock(&f, h->user, h->cnt * sizeof(int));
+    putBlock(&f, h->batch, h->cnt * sizeof(int));
+    putBlock(&f, h->vType, h->cnt * sizeof(int));
+    putBlock(&f, h->date, h->cnt * sizeof(int));
+    putBlock(&f, h->nextUser, h->cnt * sizeof(int));
+    putBlock(&f, h->live, (h->cnt + 7) / 8);
+ 
+    putInt(&f, sys->today.size);
+    putInt(&f, sys->today.used);
+    putBlock(&f, sys->today.tab, sys->today.size * sizeof(int));
+ 
+    sum = (unsigned int)f.sum;
+    putBlock(&f, &sum, sizeof(sum));
+    if(fclose(f.fp) != 0 || f.err || rename(tmp, path) != 0){
+        remove(tmp);
+        free(tmp);
+        return 0;
+    }
+    free(tmp);
+    return 1;
+}
+
+/**
+  * @brief Reads the blocks of a snapshot into an empty system.
+  *
+  * @param f Pointer to the open snapshot file.
+  * @param sys Pointer to the system.
+  */
+static void readBlocks(SnapFile *f, Sys *sys){
+    History *h = &sys->hist;
+    char magic[8];
+    int i, maxV;
+ 
+    getBlock(f, magic, 8);
+    if(f->err || memcmp(magic, SNAPMAGIC, 8) != 0 ||
+        getInt(f, SNAPVERSION, SNAPVERSION) != SNAPVERSION){
+        f->err = 1;
+        return;
+    }
+    sys->state = getInt(f, PT, ENG);
+    /* The limit never drops below the one the snapshot was taken under */
+    maxV = getInt(f, 1, 0x3FFFFFFF);
+    if(maxV > sys->maxV){
+        sys->maxV = maxV;
+    }
+    sys->gen = getInt(f, 1, 0x3FFFFFFF);
+    getBlock(f, &sys->tcurr, sizeof(Date));
+    getBlock(f, &sys->wastedDoses, sizeof(long));
+    getBlock(f, &sys->tally, sizeof(Tally));
+    sys->liveUsers = getInt(f, 0, 0x3FFFFFFF);
+ 
+    sys->cntV = getInt(f, 0, 0x3FFFFFFF);
+    sys->cntOrder = getInt(f, sys->cntV, 0x3FFFFFFF);
+    sys->cntDead = getInt(f, sys->cntOrder - sys->cntV,
+        sys->cntOrder - sys->cntV);
+    sys->nextId = getInt(f, sys->cntOrder, 0x3FFFFFFF);
+    sys->cntFree = getInt(f, 0, sys->nextId - sys->cntOrder);
+    sys->cntSorted = sys->cntOrder;
+    sys->cntExpired = getInt(f, 0, sys->cntOrder);
+    /* Room for every id in use, but no more than the limit needs */
+    sys->capV = capFor(sys->nextId, 16);
+    if(sys->capV > sys->maxV){
+        sys->capV = sys->maxV > sys->nextId ? sys->maxV : sys->nextId;
+    }
+    sys->store = getArray(f, sys->capV * sizeof(Vaccine));
+    sys->order = getArray(f, sys->capV * sizeof(int));
+    sys->freeIds = getArray(f, sys->capV * sizeof(int));
+    getBlock(f, sys->store, sys->nextId * sizeof(Vaccine));
+    getBlock(f, sys->order, sys->cntOrder * sizeof(int));
+    getBlock(f, sys->freeIds, sys->cntFree * sizeof(int));
+    sys->batches.size = getInt(f, 0, 0x3FFFFFFF);
+    sys->batches.used = getInt(f, 0, sys->cntV);
+    sys->batches.tab = getArray(f, sys->batches.size * sizeof(int));
+    getBlock(f, sys->batches.tab, sys->batches.size * sizeof(int));
+    if(f->err){
+        return;
+    }
+ 
+    getIntern(f, &sys->names.keys, &sys->arena);
+    sys->names.cap = sys->names.keys.cap;
+    sys->names.list = getArray(f, sys->names.cap * sizeof(NameEntry));
+    if(f->err){
+        sys->names.keys.cnt = 0;
+        return;
+    }
+    memset(sys->names.list, 0, sys->names.cap * sizeof(NameEntry));
+    for(i = 0; i < sys->names.keys.cnt && !f->err; i++){
+        NameEntry *e = &sys->names.list[i];
+        e->cnt = getInt(f, 0, sys->cntV);
+        e->next = getInt(f, 0, e->cnt);
+        e->sorted = e->cnt;
+        getBlock(f, &e->tally, sizeof(Tally));
+        e->cap = capFor(e->cnt, 4);
+        e->ids = getArray(f, e->cap * sizeof(int));
+        getBlock(f, e->ids, e->cnt * sizeof(int));
+    }
+ 
+    getIntern(f, &sys->users.keys, &sys->arena);
+    sys->users.cap = sys->users.keys.cap;
+    sys->users.list = getArray(f, sys->users.cap * sizeof(UserEntry));
+    getBlock(f, sys->users.list, sys->users.keys.cnt * sizeof(UserEntry));
+ 
+    h->cnt = getInt(f, 0, 0x3FFFFFFF);
+    h->dead = getInt(f, 0, h->cnt);
+    h->cap = capFor(h->cnt, 1024);
+    h->user = getArray(f, h->cap * sizeof(int));
+    h->batch = getArray(f, h->cap * sizeof(int));
+    h->vType = getArray(f, h->cap * sizeof(int));
+    h->date = getArray(f, h->cap * sizeof(int));
+    h->nextUser = getArray(f, h->cap * sizeof(int));
+    h->live = getArray(f, h->cap / 8);
+    if(f->err){
+        return;
+    }
+    getBlock(f, h->user, h->cnt * sizeof(int));
+    getBlock(f, h->batch, h->cnt * sizeof(int));
+    getBlock(f, h->vType, h->cnt * sizeof(int));
+    getBlock(f, h->date, h->cnt * sizeof(int));
+    getBlock(f, h->nextUser, h->cnt * sizeof(int));
+    memset(h->live, 0, h->cap / 8);
+    getBlock(f, h->live, (h->cnt + 7) / 8);
+ 
+    sys->today.size = getInt(f, 0, 0x3FFFFFFF);
+    sys->today.used = getInt(f, 0, h->cnt);
+    sys->today.tab = getArray(f, sys->today.size * sizeof(int));
+    getBlock(f, sys->today.tab, sys->today.size * sizeof(int));
+}
+
+/**
+  * @brief Restores the system from a snapshot file.
+  *
+  * The system must be empty. If the file is unreadable, of another
+  * version or fails its checksum, whatever was restored must still be
+  * released with freeSys().
+  *
+  * @param sys Pointer to the system.
+  * @param path Snapshot file.
+  * @return 1 on success, 0 otherwise.
+  */
+int loadSnapshot(Sys *sys, const char *path){
+    SnapFile f = {NULL, FNVSEED, 0};
+    unsigned int sum = 0;
+ 
+    f.fp = fopen(path, "rb");
+    if(f.fp == NULL){
+        return 0;
+    }
+    readBlocks(&f, sys);
+    if(!f.err && (fread(&sum, sizeof(sum), 1, f.fp) != 1 ||
+        sum != (unsigned int)f.sum)){
+        f.err = 1;
+    }
+    fclose(f.fp);
+    return !f.err;
+}
+
+/**
+  * @brief Saves a snapshot of the system to the file named in the command.
+  *
+  * Prints nothing on success, and an error if the snapshot cannot be
+  * written. The journal, if any, then starts over in the snapshot's
+  * generation, since the snapshot already holds everything it recorded;
+  * if the program stops before that, replay skips the records of older
+  * generations. If the journal cannot be opened again, the snapshot
+  * stands but nothing is journaled from then on, which is reported as a
+  * lost journal.
+  *
+  * @param sys Pointer to the system.
+  * @param in Input string containing the file name.
+  */
+void saveSnapshot(Sys *sys, char *in){
+    Token path = {"", 0};
+    char *cur = in + 1;
+    nextToken(&cur, &path);
+    if(path.len == 0 || !writeSnapshot(sys, path.s)){
+        outError(&sys->out, sys->state, PTENOSAVE, ENGENOSAVE);
+    }else if(!restartJournal(&sys->journal, sys->maxV, ++sys->gen)){
+        outError(&sys->out, sys->state, PTELOSTJOURNAL, ENGELOSTJOURNAL);
+    }
+}
@@ -0,0 +1,12 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "project.h"
+
+
+/* Function prototypes related to snapshots of the system */
+void saveSnapshot(Sys *sys, char *in);
+int writeSnapshot(Sys *sys, const char *path);
+int loadSnapshot(Sys *sys, const char *path);
+
+#endif /* SNAPSHOT_H */
@@ -0,0 +1,178 @@
+/**
+ * @file stats.c
+ * @brief Runtime counters and the stats command.
+ *
+ * Only built with -DSTATS; without it the dispatch and the output carry
+ * no counters at all. Commands are counted by letter together with the
+ * error messages they print, and the sizes of the structures are read
+ * off the system when the counters are printed.
+ */
+
+#include "stats.h"
+
+#ifdef STATS
+
+#include "output.h"
+#include "latency.h"
+
+/**
+  * @brief Fills in every error message, in English, in the order of
+  * Output::errors.
+  *
+  * @param names Array of NERRMSG messages to fill in.
+  */
+static void errorNames(const char *names[NERRMSG]){
+    const char *all[NERRMSG] = {
+        ENGE2MANYVAC, ENGEDUPBATCH, ENGEINVBATCH, ENGEINVNAME, ENGEINVDATE,
+        ENGEINVQUANT, ENGENOVACCINE, ENGENOSTOCK, ENGEALRVACC, ENGENOBATCH,
+        ENGENOUSER, ENGENOMEMORY, ENGENOSAVE, ENGEBADSNAP, ENGEBADJOURNAL,
+        ENGELOSTJOURNAL
+    };
+    memcpy(names, all, sizeof(all));
+}
+
+/**
+  * @brief Counts an error message being printed.
+  *
+  * @param out Pointer to the output.
+  * @param eng English text of the message.
+  */
+void countError(Output *out, const char *eng){
+    const char *names[NERRMSG];
+    int i;
+    out->errorCnt++;
+    errorNames(names);
+    for(i = 0; i < NERRMSG; i++){
+        if(strcmp(names[i], eng) == 0){
+            out->errors[i]++;
+            return;
+        }
+    }
+}
+
+/**
+  * @brief Records a command that just ran.
+  *
+  * @param sys Pointer to the system.
+  * @param cmd Command letter.
+  * @param start Clock reading taken before the command (if any clock).
+  * @param errs Output::errorCnt before the command.
+  */
+void recordCommand(Sys *sys, char cmd, long start, long errs){
+    Stats *st = &sys->stats;
+    int c = cmd - 'a';
+    if(c < 0 || c >= 26){
+        return;
+    }
+    st->calls[c]++;
+    st->errs[c] += sys->out.errorCnt - errs;
+    if(st->clock != NULL){
+        st->lat[c][latBucket(st->clock() - start)]++;
+    }
+}
+
+/**
+  * @brief Returns the bytes held by an intern table, strings excluded.
+  *
+  * @param t Pointer to the table.
+  * @return Number of bytes.
+  */
+static long internBytes(Intern *t){
+    return (long)(t->size * sizeof(int) + t->cap * sizeof(char *));
+}
+
+/**
+  * @brief Returns the bytes allocated by the system.
+  *
+  * @param sys Pointer to the system.
+  * @return Number of bytes.
+  */
+static long sysBytes(Sys *sys){
+    long bytes = (long)(sizeof(Sys) + sys->arena.bytes);
+    int i;
+    bytes += (long)sys->capV * (sizeof(Vaccine) + 2 * sizeof(int));
+    bytes += (long)sys->hist.cap * (5 * sizeof(int)) + sys->hist.cap / 8;
+    bytes += (long)(sys->batches.size + sys->today.size) * sizeof(int);
+    bytes += internBytes(&sys->names.keys) + internBytes(&sys->users.keys);
+    bytes += (long)sys->names.cap * sizeof(NameEntry);
+    bytes += (long)sys->users.cap * sizeof(UserEntry);
+    for(i = 0; i < sys->names.keys.cnt; i++){
+        bytes += (long)sys->names.list[i].cap * sizeof(int);
+    }
+    return bytes;
+}
+
+/**
+  * @brief Prints a name followed by a number on a line of its own.
+  *
+  * @param out Pointer to the output.
+  * @param name Name.
+  * @param v Number.
+  */
+static void outCounter(Output *out, const char *name, long v){
+    outStr(out, name);
+    outChar(out, ' ');
+    outInt(out, v);
+    outChar(out, '\n');
+}
+
+/**
+  * @brief Prints the counters and the sizes of the structures.
+  *
+  * One line per structure size, then the number of mallocs made by the
+  * arena of names, then one line per command that ran,
+  * "command <letter> <calls> <errors>", followed by its p50, p90, p99
+  * and maximum latency in nanoseconds when a clock is available, then one
+  * line per error message printed, "error <message>: <count>".
+  *
+  * @param sys Pointer to the system.
+  * @param in Input string (unused).
+  */
+void printStats(Sys *sys, char *in){
+    Stats *st = &sys->stats;
+    Output *out = &sys->out;
+    const char *names[NERRMSG];
+    int c, i;
+    (void)in;
+ 
+    outCounter(out, "batches", sys->cntV);
+    outCounter(out, "inoculations", sys->hist.cnt);
+    outCounter(out, "vaccines", sys->names.keys.cnt);
+    outCounter(out, "users", sys->users.keys.cnt);
+    outCounter(out, "bytes", sysBytes(sys));
+    outCounter(out, "arena-mallocs", sys->arena.mallocs);
+    for(c = 0; c < 26; c++){
+        if(st->calls[c] == 0){
+            continue;
+        }
+        outStr(out, "command ");
+        outChar(out, (char)('a' + c));
+        outChar(out, ' ');
+        outInt(out, st->calls[c]);
+        outChar(out, ' ');
+        outInt(out, st->errs[c]);
+        if(st->clock != NULL){
+            outChar(out, ' ');
+            outInt(out, latPercentile(st->lat[c], st->calls[c], 50));
+            outChar(out, ' ');
+            outInt(out, latPercentile(st->lat[c], st->calls[c], 90));
+            outChar(out, ' ');
+            outInt(out, latPercentile(st->lat[c], st->calls[c], 99));
+            outChar(out, ' ');
+            outInt(out, latPercentile(st->lat[c], st->calls[c], 100));
+        }
+        outChar(out, '\n');
+    }
+    errorNames(names);
+    for(i = 0; i < NERRMSG; i++){
+        if(out->errors[i] > 0){
+            outStr(out, "error ");
+            outStr(out, names[i]);
+            outStr(out, ": ");
+            outInt(out, out->errors[i]);
+            outChar(out, '\n');
+        }
+    }
+}
+
+#endif /* STATS */
@@ -0,0 +1,15 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include "project.h"
+
+#ifdef STATS
+
+/* Function prototypes related to runtime counters */
+void countError(Output *out, const char *eng);
+void recordCommand(Sys *sys, char cmd, long start, long errs);
+void printStats(Sys *sys, char *in);
+
+#endif /* STATS */
+
+#endif /* STATS_H */
@@ -0,0 +1,122 @@
+/**
+ * @file summary.c
+ * @brief Running totals of doses and inoculations, and the 's' command.
+ *
+ * Every command that changes a batch's doses or adds or deletes a record
+ * updates the totals of its vaccine and of the whole system on the spot,
+ * so a summary costs the same whatever the size of the history.
+ */
+
+#include "summary.h"
+#include "nameindex.h"
+#include "parser.h"
+#include "output.h"
+#include "utils.h"
+
+/**
+  * @brief Adds to the inoculations counted by a tally.
+  *
+  * @param t Pointer to the tally.
+  * @param date Packed date of the inoculations.
+  * @param today Packed current date.
+  * @param n Number of inoculations (negative when deleted).
+  */
+static void tallyRecord(Tally *t, int date, int today, int n){
+    t->applys += n;
+    if(date == today){
+        if(t->day != today){
+            t->day = today;
+            t->today = 0;
+        }
+        t->today += n;
+    }
+}
+
+/**
+  * @brief Returns today's inoculations counted by a tally.
+  *
+  * @param t Pointer to the tally.
+  * @param today Packed current date.
+  * @return Number of inoculations.
+  */
+static long todayOf(Tally *t, int today){
+    return t->day == today ? t->today : 0;
+}
+
+/**
+  * @brief Adds to the doses left of a vaccine.
+  *
+  * @param sys Pointer to the system.
+  * @param nameId Id of the vaccine name.
+  * @param n Number of doses (negative when used up or lost).
+  */
+void countDoses(Sys *sys, int nameId, long n){
+    sys->names.list[nameId].tally.doses += n;
+    sys->tally.doses += n;
+}
+
+/**
+  * @brief Adds to the inoculations of a vaccine.
+  *
+  * @param sys Pointer to the system.
+  * @param nameId Id of the vaccine name.
+  * @param date Packed date of the inoculations.
+  * @param n Number of inoculations (negative when deleted).
+  */
+void countRecord(Sys *sys, int nameId, int date, int n){
+    int today = packDate(sys->tcurr);
+    tallyRecord(&sys->names.list[nameId].tally, date, today, n);
+    tallyRecord(&sys->tally, date, today, n);
+}
+
+/**
+  * @brief Prints the running totals.
+  *
+  * Without names, prints the doses left, the inoculations, today's
+  * inoculations, the users with inoculations and the doses lost to
+  * expiry, over all vaccines. With names, prints the first three for
+  * each vaccine, in the order given.
+  *
+  * @param sys Pointer to the system.
+  * @param in Input string.
+  */
+void showSummary(Sys *sys, char *in){
+    Token name;
+    char *cur = in + 1;
+    int today = packDate(sys->tcurr);
+
+    if(!nextToken(&cur, &name)){
+        outInt(&sys->out, sys->tally.doses);
+        outChar(&sys->out, ' ');
+        outInt(&sys->out, sys->tally.applys);
+        outChar(&sys->out, ' ');
+        outInt(&sys->out, todayOf(&sys->tally, today));
+        outChar(&sys->out, ' ');
+        outInt(&sys->out, sys->liveUsers);
+        outChar(&sys->out, ' ');
+        outInt(&sys->out, sys->wastedDoses);
+        outChar(&sys->out, '\n');
+        return;
+    }
+
+    do{
+        int id = findName(&sys->names, name.s);
+        NameEntry *e = id == -1 ? NULL : &sys->names.list[id];
+        Tally *t = e == NULL ? NULL : &e->tally;
+        /* A vaccine exists while it has a batch, as for 'l' */
+        if(e == NULL || e->cnt == 0){
+            outStr(&sys->out, name.s);
+            outStr(&sys->out, ": ");
+            outError(&sys->out, sys->state, PTENOVACCINE, ENGENOVACCINE);
+            continue;
+        }
+        outStr(&sys->out, name.s);
+        outChar(&sys->out, ' ');
+        outInt(&sys->out, t->doses);
+        outChar(&sys->out, ' ');
+        outInt(&sys->out, t->applys);
+        outChar(&sys->out, ' ');
+        outInt(&sys->out, todayOf(t, today));
+        outChar(&sys->out, '\n');
+    }while(nextToken(&cur, &name));
+}
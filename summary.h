@@ -0,0 +1,12 @@
+#ifndef SUMMARY_H
+#define SUMMARY_H
+
+#include "project.h"
+
+
+/* Function prototypes related to the running totals */
+void countDoses(Sys *sys, int nameId, long n);
+void countRecord(Sys *sys, int nameId, int date, int n);
+void showSummary(Sys *sys, char *in);
+
+#endif /* SUMMARY_H */
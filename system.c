@@ -0,0 +1,128 @@
+/**
+ * @file system.c
+ * @brief Lifetime of the system structure.
+ */
+
+#include "system.h"
+#include "nameindex.h"
+#include "batchindex.h"
+#include "userindex.h"
+#include "dayset.h"
+#include "arena.h"
+#include "history.h"
+#include "vaccine.h"
+#include "inoculations.h"
+#include "time.h"
+#include "snapshot.h"
+#include "journal.h"
+#include "stats.h"
+#include "scan.h"
+#include "summary.h"
+#include "intern.h"
+#include "output.h"
+
+/**
+  * @brief Creates an empty system.
+  *
+  * The system is kept on the heap: its output buffer alone would make for
+  * a large stack frame.
+  *
+  * @return Pointer to the system, or NULL if memory is exhausted.
+  */
+Sys *newSys(void){
+    Sys *sys = calloc(1, sizeof(Sys));
+    if(sys != NULL){
+        sys->state = ENG;
+        sys->tcurr.day = sys->tcurr.month = 1;
+        sys->tcurr.year = 2025;
+        sys->maxV = MAXBATCHES;
+        sys->compactPct = COMPACTPCT;
+        sys->out.fp = stdout;
+    }
+    return sys;
+}
+
+/**
+  * @brief Frees the system, with all the memory it owns, and closes its
+  * journal.
+  *
+  * @param sys Pointer to the system.
+  */
+void freeSys(Sys *sys){
+    freeNameIndex(&sys->names);
+    freeBatchIndex(&sys->batches);
+    freeUserIndex(&sys->users);
+    freeDaySet(&sys->today);
+    freeArena(&sys->arena);
+    freeHistory(&sys->hist);
+    closeJournal(&sys->journal);
+    freeScans(sys);
+    freeIntern(&sys->closed);
+    free(sys->store);
+    free(sys->order);
+    free(sys->freeIds);
+    free(sys);
+}
+
+/**
+  * @brief Runs one command line.
+  *
+  * The 'q' command is left to the caller, which owns the input.
+  *
+  * @param sys Pointer to the system.
+  * @param buf Command line (tokenized in place).
+  */
+void runCommand(Sys *sys, char *buf){
+#ifdef STATS
+    long start = sys->stats.clock != NULL ? sys->stats.clock() : 0;
+    long errs = sys->out.errorCnt;
+#endif
+    switch(buf[0]){
+        case 'c': createBatch(sys, buf); break;
+        case 'l': listVaccines(sys, buf); break;
+        case 'a': applyVaccine(sys, buf); break;
+        case 'b': bulkApply(sys, buf); break;
+        case 'r': deleteVaccines(sys, buf); break;
+        case 'd': deleteHistory(sys, buf); break;
+        case 'u': listClientHistory(sys, buf); break;
+        case 't': timeControl(sys, buf); break;
+        case 'w': saveSnapshot(sys, buf); break;
+        case 's': showSummary(sys, buf); break;
+#ifdef STATS
+        case 'x': printStats(sys, buf); break;
+#endif
+    }
+#ifdef STATS
+    recordCommand(sys, buf[0], start, errs);
+#endif
+}
+
+/**
+  * @brief Selects the session of a command line.
+  *
+  * Lines of a session that quit are ignored, and a session's 'q' only
+  * ends that session. Before a session's command runs, its pending
+  * listings are finished, so that it sees its results in order.
+  *
+  * @param sys Pointer to the system.
+  * @param line Command line, possibly tagged with a session.
+  * @return The command to run, or NULL if there is none.
+  */
+char *sessionLine(Sys *sys, char *line){
+    char *cmd = outSession(&sys->out, line);
+    const char *tag = sys->out.tag;
+    if(tag == NULL){
+        return cmd;
+    }
+    if(internFind(&sys->closed, tag) != -1){
+        return NULL;
+    }
+    finishScans(sys, tag, sys->out.tagLen);
+    if(cmd[0] == 'q'){
+        if(internAdd(&sys->closed, &sys->arena, tag) == -1){
+            outError(&sys->out, sys->state, PTENOMEMORY, ENGENOMEMORY);
+        }
+        return NULL;
+    }
+    return cmd;
+}
@@ -0,0 +1,13 @@
+#ifndef SYSTEM_H
+#define SYSTEM_H
+
+#include "project.h"
+
+
+/* Function prototypes related to the system as a whole */
+Sys *newSys(void);
+void freeSys(Sys *sys);
+void runCommand(Sys *sys, char *buf);
+char *sessionLine(Sys *sys, char *line);
+
+#endif /* SYSTEM_H */
@@ -5,32 +5,42 @@
 
 #include "time.h"
 #include "utils.h"
+#include "dayset.h"
+#include "vaccine.h"
+#include "parser.h"
+#include "output.h"
 
 /**
   * @brief Updates the system's current simulated date.
   *
-  * If the new date is invalid or earlier than the current date,
-  * prints an error message.
+  * Without a date, only prints the current one. If the new date is
+  * invalid or earlier than the current date, prints an error message.
+  * Moving to a later date forgets the set of inoculations made on the
+  * previous one and retires expired batches.
   *
   * @param sys Pointer to the system.
   * @param in Input string containing the new date.
   */
 void timeControl(Sys *sys, char *in){
     Date temp;
-    if(sscanf(in, "%*s %2d-%2d-%d", &temp.day, &temp.month, &temp.year) < 1){
-        printf("%.2d-%.2d-%d\n", sys->tcurr.day,
-            sys->tcurr.month, sys->tcurr.year);
+    Token date;
+    char *cur = in + 1;
+    if(!nextToken(&cur, &date) || (!isdigit((unsigned char)date.s[0]) &&
+        date.s[0] != '-' && date.s[0] != '+')){
+        outDate(&sys->out, sys->tcurr);
+        outChar(&sys->out, '\n');
         return;
-    }else if((!verifyDate(temp))||(compareDates(sys->tcurr, temp) > 0)){
-        if(sys->state == PT){
-            puts(PTEINVDATE);
-        }else{
-            puts(ENGEINVDATE);
-        }
+    }else if(!parseDate(&date, &temp) || (!verifyDate(temp)) ||
+        (compareDates(sys->tcurr, temp) > 0)){
+        outError(&sys->out, sys->state, PTEINVDATE, ENGEINVDATE);
         return;
     }else{
+        if(compareDates(sys->tcurr, temp) != 0){
+            clearDaySet(&sys->today);
+        }
         sys->tcurr = temp;
-        printf("%.2d-%.2d-%d\n", sys->tcurr.day,
-            sys->tcurr.month, sys->tcurr.year);
+        retireExpired(sys);
+        outDate(&sys->out, sys->tcurr);
+        outChar(&sys->out, '\n');
     }
 }
\ No newline at end of file
@@ -0,0 +1,76 @@
+/**
+ * @file userindex.c
+ * @brief Index of inoculations grouped by user.
+ *
+ * Each user name is interned, and its id maps to the chain of its
+ * inoculation records, linked through History::nextUser in order of
+ * application.
+ */
+
+#include "userindex.h"
+#include "intern.h"
+
+/**
+  * @brief Looks up a user.
+  *
+  * @param idx Pointer to the index.
+  * @param name User name.
+  * @return The id of the user, or -1 if it was never registered.
+  */
+int findUser(UserIndex *idx, const char *name){
+    return internFind(&idx->keys, name);
+}
+
+/**
+  * @brief Looks up a user, registering it if needed.
+  *
+  * The name of a new user is copied into the arena, where it is shared by
+  * all inoculations of that user.
+  *
+  * @param idx Pointer to the index.
+  * @param arena Arena holding the user names.
+  * @param name User name.
+  * @return The id of the user, or -1 if memory is exhausted.
+  */
+int addUser(UserIndex *idx, Arena *arena, const char *name){
+    int id, cnt = idx->keys.cnt;
+    if(idx->keys.cnt == idx->cap){
+        int newCap = idx->cap ? idx->cap * 2 : 64;
+        UserEntry *list = realloc(idx->list, newCap * sizeof(UserEntry));
+        if(list == NULL){
+            return -1;
+        }
+        idx->list = list;
+        idx->cap = newCap;
+    }
+    id = internAdd(&idx->keys, arena, name);
+    if(idx->keys.cnt > cnt){
+        idx->list[id].first = idx->list[id].last = -1;
+    }
+    return id;
+}
+
+/**
+  * @brief Returns the name of a user.
+  *
+  * @param idx Pointer to the index.
+  * @param id Id of the user.
+  * @return The user name.
+  */
+const char *userNameOf(UserIndex *idx, int id){
+    return idx->keys.strs[id];
+}
+
+/**
+  * @brief Frees all memory used by the index.
+  *
+  * The names themselves belong to the arena.
+  *
+  * @param idx Pointer to the index.
+  */
+void freeUserIndex(UserIndex *idx){
+    free(idx->list);
+    idx->list = NULL;
+    idx->cap = 0;
+    freeIntern(&idx->keys);
+}
@@ -0,0 +1,13 @@
+#ifndef USERINDEX_H
+#define USERINDEX_H
+
+#include "project.h"
+
+
+/* Function prototypes related to the user index */
+int findUser(UserIndex *idx, const char *name);
+int addUser(UserIndex *idx, Arena *arena, const char *name);
+const char *userNameOf(UserIndex *idx, int id);
+void freeUserIndex(UserIndex *idx);
+
+#endif /* USERINDEX_H */
@@ -1,6 +1,6 @@
 /**
  * @file utils.c
- * @brief Utility functions for date handling.
+ * @brief Utility functions for date handling and hashing.
  */
 
 #include "utils.h"
@@ -24,11 +24,16 @@
 /**
   * @brief Checks if a date is valid.
   *
+  * Years past MAXYEAR are refused, since their packed form would not fit
+  * in an int.
+  *
   * @param date The date to check.
   * @return 1 if valid, 0 otherwise.
   */
 int verifyDate(Date date){
-    if(1 > date.month || 12 < date.month){
+    if(date.year < 0 || date.year > MAXYEAR){
+        return 0;
+    }else if(1 > date.month || 12 < date.month){
         return 0;
     }else if(date.day > daysInM(date.month, date.year) || date.day < 1){
         return 0;
@@ -52,3 +57,60 @@ int compareDates(Date d1, Date d2){
     }
     return d1.day - d2.day;
 }
+
+/**
+  * @brief Packs a date into a single integer.
+  *
+  * Packed dates compare in the same order as compareDates().
+  *
+  * @param date The date to pack.
+  * @return The packed date.
+  */
+int packDate(Date date){
+    return date.year * 512 + date.month * 32 + date.day;
+}
+
+/**
+  * @brief Unpacks a date produced by packDate().
+  *
+  * @param packed The packed date.
+  * @return The date.
+  */
+Date unpackDate(int packed){
+    Date date;
+    date.year = packed / 512;
+    date.month = packed / 32 % 16;
+    date.day = packed % 32;
+    return date;
+}
+
+/**
+  * @brief Computes the djb2 hash of a string.
+  *
+  * @param s Null-terminated string.
+  * @return Hash value.
+  */
+unsigned long hashString(const char *s){
+    unsigned long h = 5381;
+    while(*s){
+        h = h * 33 + (unsigned char)*s;
+        s++;
+    }
+    return h;
+}
+
+/**
+  * @brief Continues a 32-bit FNV-1a checksum over some bytes.
+  *
+  * @param h Checksum so far (FNVSEED for the first bytes).
+  * @param p Bytes.
+  * @param n Number of bytes.
+  * @return Updated checksum.
+  */
+unsigned long checksum(unsigned long h, const void *p, size_t n){
+    const unsigned char *b = p;
+    while(n-- > 0){
+        h = ((h ^ *b++) * 16777619UL) & 0xFFFFFFFFUL;
+    }
+    return h;
+}
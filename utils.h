@@ -7,5 +7,11 @@
 int daysInM(int month, int year);
 int verifyDate(Date date);
 int compareDates(Date d1, Date d2);
+int packDate(Date date);
+Date unpackDate(int packed);
+
+/* Function prototypes related to hashing */
+unsigned long hashString(const char *s);
+unsigned long checksum(unsigned long h, const void *p, size_t n);
 
 #endif /* UTILS_H */
\ No newline at end of file
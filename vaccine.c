@@ -4,163 +4,310 @@
  */
 
 #include "vaccine.h"
+#include "nameindex.h"
+#include "batchindex.h"
+#include "parser.h"
+#include "output.h"
 #include "utils.h"
+#include "scan.h"
+#include "summary.h"
+
+/**
+  * @brief Tells whether enough of a sequence is dead to compact it.
+  *
+  * @param sys Pointer to the system.
+  * @param dead Dead entries.
+  * @param total Entries, dead ones included.
+  * @return 1 if the sequence should be compacted, 0 otherwise.
+  */
+int worthCompacting(Sys *sys, int dead, int total){
+    return dead >= COMPACTMIN &&
+        (long)dead * 100 > (long)sys->compactPct * total;
+}
+
+/**
+  * @brief Drops the removed batches from the listing order.
+  *
+  * Their ids only become free now, since until then the order still
+  * refers to them; pending listings, which may refer to them too, are
+  * finished first.
+  *
+  * @param sys Pointer to the system.
+  */
+static void compactBatches(Sys *sys){
+    int i, j = 0, expired = 0;
+    finishScans(sys, NULL, 0);
+    mergeOrder(sys);
+    for(i = 0; i < sys->cntOrder; i++){
+        int id = sys->order[i];
+        if(sys->store[id].dead){
+            sys->freeIds[sys->cntFree++] = id;
+        }else{
+            expired += i < sys->cntExpired;
+            sys->order[j++] = id;
+        }
+    }
+    sys->cntOrder = sys->cntSorted = j;
+    sys->cntDead = 0;
+    sys->cntExpired = expired;
+}
+
+/**
+  * @brief Makes sure one more batch fits, growing the batch store.
+  *
+  * The store, the listing order and the free id stack grow together,
+  * doubling up to the limit sys->maxV. The ids in use are exactly those
+  * in the order, so they always fit too. When the order is full of
+  * removed batches, or cannot grow, it is compacted instead. The store
+  * never shrinks, even if it was allocated past the limit.
+  *
+  * @param sys Pointer to the system.
+  * @return 1 on success, 0 if memory is exhausted.
+  */
+static int reserveBatch(Sys *sys){
+    int newCap;
+    Vaccine *store;
+    int *order, *freeIds;
+ 
+    if(sys->cntOrder < sys->capV){
+        return 1;
+    }
+    if(sys->cntDead > 0 && (sys->capV >= sys->maxV ||
+        worthCompacting(sys, sys->cntDead, sys->cntOrder))){
+        compactBatches(sys);
+        if(sys->cntOrder < sys->capV){
+            return 1;
+        }
+    }
+    newCap = sys->capV ? sys->capV * 2 : 16;
+    if(newCap > sys->maxV){
+        newCap = sys->maxV;
+    }
+    if(newCap <= sys->cntOrder){
+        return 0;
+    }
+    store = realloc(sys->store, newCap * sizeof(Vaccine));
+    if(store == NULL){
+        return 0;
+    }
+    sys->store = store;
+    order = realloc(sys->order, newCap * sizeof(int));
+    if(order == NULL){
+        return 0;
+    }
+    sys->order = order;
+    freeIds = realloc(sys->freeIds, newCap * sizeof(int));
+    if(freeIds == NULL){
+        return 0;
+    }
+    sys->freeIds = freeIds;
+    sys->capV = newCap;
+    return 1;
+}
+
+/**
+  * @brief Merges the run of new batches at the end of the order into it.
+  *
+  * The run is merged from the back: each new batch finds its place by
+  * binary search, and the batches after it move up in one block, so
+  * only the batches that come after the first new one move, and they are
+  * never compared. The free id stack holds the run meanwhile: every id
+  * is either in the order or on the stack, so the stack always has room
+  * for a copy of the order.
+  *
+  * @param sys Pointer to the system.
+  */
+void mergeOrder(Sys *sys){
+    int *order = sys->order, *run = sys->freeIds + sys->cntFree;
+    int end = sys->cntSorted, j = sys->cntOrder - sys->cntSorted - 1;
+    if(j < 0){
+        return;
+    }
+    memcpy(run, &order[end], (j + 1) * sizeof(int));
+    for(; j >= 0; j--){
+        int p = findBatchPos(sys, 0, end, &sys->store[run[j]]);
+        /* The j new batches before this one still go before p */
+        memmove(&order[p + j + 1], &order[p], (end - p) * sizeof(int));
+        order[p + j] = run[j];
+        end = p;
+    }
+    sys->cntSorted = sys->cntOrder;
+}
+
+/**
+  * @brief Adds a new batch, already present in sys->store, to the order.
+  *
+  * Inserting each batch in place would shift half the order on average,
+  * which makes creating n batches quadratic. New batches go into a
+  * sorted run at the end of the order instead, which is merged in once
+  * it holds about the square root of the order: each creation then moves
+  * O(sqrt(n)) ids. Readers of the whole order merge it first.
+  *
+  * @param sys Pointer to the system.
+  * @param id Id of the new batch.
+  */
+static void insertOrder(Sys *sys, int id){
+    int run = sys->cntOrder - sys->cntSorted, i;
+    if(run >= ORDERRUN && (long)run * run >= sys->cntOrder){
+        mergeOrder(sys);
+    }
+    i = findBatchPos(sys, sys->cntSorted, sys->cntOrder, &sys->store[id]);
+    memmove(&sys->order[i + 1], &sys->order[i],
+        (sys->cntOrder - i) * sizeof(int));
+    sys->order[i] = id;
+    sys->cntOrder += 1;
+}
 
 /**
   * @brief Creates a new vaccine batch and adds it to the system.
   *
   * Reads input parameters from the provided string and inserts
-  * a new batch into the system's list. Prints error messages if necessary.
+  * a new batch into the system's list, keeping it sorted by expiration
+  * date and batch. Prints error messages if necessary.
   *
   * @param sys Pointer to the system.
   * @param in Input string containing the batch data.
   */
 void createBatch(Sys *sys, char *in){
     Vaccine vacc;
-    int i;
-    char *tempBatch = (char *)malloc(BUFMAX * sizeof(char));
-    char *tempName = (char *)malloc(BUFMAX * sizeof(char));
+    NameEntry *e;
+    Token batch = {"", 0}, date = {"", 0}, doses = {"", 0}, name = {"", 0};
+    char *cur = in + 1;
+    int valid;
  
-    if(tempBatch == NULL || tempName == NULL){
-        puts(sys->state == PT ? PTENOMEMORY : ENGENOMEMORY);
-        return;
+    nextToken(&cur, &batch);
+    nextToken(&cur, &date);
+    nextToken(&cur, &doses);
+    nextToken(&cur, &name);
+    if(!parseDate(&date, &vacc.expir)){
+        vacc.expir.day = vacc.expir.month = vacc.expir.year = 0;
     }
- 
-    sscanf(in, "%*s %s %d-%d-%d %d %s", tempBatch,
-        &vacc.expir.day, &vacc.expir.month, &vacc.expir.year,
-        &vacc.doses, tempName);
-    if(sys->cntV >= MAXBATCHES){
-        puts(sys->state == PT ? PTE2MANYVAC : ENGE2MANYVAC);
-        free(tempBatch);
-        free(tempName);
-        return;
+    if(!parseInt(&doses, &vacc.doses)){
+        vacc.doses = 0;
     }
+    valid = parseBatch(&batch, &vacc.key);
  
-    for(i = 0; i < sys->cntV; i++){
-         if(!strcmp(sys->arr[i].batch, tempBatch)){
-            puts(sys->state == PT ? PTEDUPBATCH : ENGEDUPBATCH);
-            free(tempBatch);
-            free(tempName);
-            return;
-        }
+    if(sys->cntV >= sys->maxV){
+        outError(&sys->out, sys->state, PTE2MANYVAC, ENGE2MANYVAC);
+        return;
     }
  
-    if(strlen(tempBatch) > MAXSIZEBATCH){
-        puts(sys->state == PT ? PTEINVBATCH : ENGEINVBATCH);
-        free(tempBatch);
-        free(tempName);
+    /* Only valid identifiers are ever stored, so only they can clash */
+    if(valid && findBatch(sys, &vacc.key) != -1){
+        outError(&sys->out, sys->state, PTEDUPBATCH, ENGEDUPBATCH);
         return;
     }
  
-    strcpy(vacc.batch, tempBatch);
- 
-    for(i = 0; i < (int)strlen(vacc.batch); i++){
-        if(!((vacc.batch[i] >= '0' && vacc.batch[i] <= '9') ||
-            (vacc.batch[i] >= 'A' && vacc.batch[i] <= 'F'))){
-            puts(sys->state == PT ? PTEINVBATCH : ENGEINVBATCH);
-            free(tempBatch);
-            free(tempName);
-            return;
-        }
+    if(!valid){
+        outError(&sys->out, sys->state, PTEINVBATCH, ENGEINVBATCH);
+        return;
     }
  
-     if(strlen(tempName) > MAXNAMEVACC){
-        puts(sys->state == PT ? PTEINVNAME : ENGEINVNAME);
-        free(tempBatch);
-        free(tempName);
+    if(name.len == 0 || name.len >= MAXNAMEVACC){
+        outError(&sys->out, sys->state, PTEINVNAME, ENGEINVNAME);
         return;
     }
  
-    strcpy(vacc.name, tempName);
- 
     if(!verifyDate(vacc.expir) ||
         (compareDates(sys->tcurr, vacc.expir) > 0)){
-        puts(sys->state == PT ? PTEINVDATE : ENGEINVDATE);
-        free(tempBatch);
-        free(tempName);
+        outError(&sys->out, sys->state, PTEINVDATE, ENGEINVDATE);
         return;
     }
  
     if(vacc.doses < 1){
-        puts(sys->state == PT ? PTEINVQUANT : ENGEINVQUANT);
-        free(tempBatch);
-        free(tempName);
+        outError(&sys->out, sys->state, PTEINVQUANT, ENGEINVQUANT);
+        return;
+    }
+ 
+    strcpy(vacc.name, name.s);
+    vacc.nameId = addName(&sys->names, &sys->arena, vacc.name);
+    e = vacc.nameId == -1 ? NULL : &sys->names.list[vacc.nameId];
+    if(e == NULL || !reserveNameBatch(e) || !reserveBatch(sys) ||
+        !reserveBatchIndex(sys)){
+        outError(&sys->out, sys->state, PTENOMEMORY, ENGENOMEMORY);
         return;
     }
  
     vacc.applys = 0;
-    sys->arr[sys->cntV] = vacc;
+    vacc.dead = 0;
+    vacc.id = sys->cntFree > 0 ? sys->freeIds[--sys->cntFree] : sys->nextId++;
+    sys->store[vacc.id] = vacc;
+    /* Insert in order so that readers never need to sort */
+    insertOrder(sys, vacc.id);
     sys->cntV += 1;
-    printf("%s\n", vacc.batch);
-    free(tempBatch);
-    free(tempName);
+    insertNameBatch(sys, e, vacc.id);
+    insertBatchId(sys, vacc.id);
+    countDoses(sys, vacc.nameId, vacc.doses);
+    outBatch(&sys->out, vacc.key);
+    outChar(&sys->out, '\n');
 }
 
 /**
-  * @brief Merges two sorted subarrays of vaccines.
+  * @brief Compares two vaccine batches by their listing order.
   *
-  * The subarrays are arr[l..m] and arr[m+1..r]. Sorting is done
-  * first by expiration date (validade) and then by batch (lote).
+  * Batches are ordered first by expiration date and then by batch
+  * identifier.
   *
-  * @param arr Array of vaccines.
-  * @param l Left index.
-  * @param m Middle index.
-  * @param r Right index.
+  * @param v1 First batch.
+  * @param v2 Second batch.
+  * @return Negative if v1 comes first, zero if equal, positive otherwise.
   */
-void merge(Vaccine arr[], int l, int m, int r){
-    int i, j, k;
-    int n1 = m - l + 1;
-    int n2 = r - m;
- 
-    Vaccine L[n1], R[n2];
- 
-    for (i = 0; i < n1; i++){
-        L[i] = arr[l + i];
+int compareBatches(const Vaccine *v1, const Vaccine *v2){
+    int cmp = compareDates(v1->expir, v2->expir);
+    if(cmp != 0){
+        return cmp;
     }
-    for (j = 0; j < n2; j++){
-        R[j] = arr[m + 1 + j];
+    if(v1->key.hi != v2->key.hi){
+        return v1->key.hi < v2->key.hi ? -1 : 1;
     }
- 
-    i = 0, j = 0, k = l;
-    while (i < n1 && j < n2){
-        if(compareDates(L[i].expir, R[j].expir) < 0 ||
-            (compareDates(L[i].expir, R[j].expir) == 0 &&
-            strcmp(L[i].batch, R[j].batch) <= 0)){
-            arr[k] = L[i];
-            i++;
-         }else{
-            arr[k] = R[j];
-            j++;
-        }
-        k++;
-    }
- 
-    while(i < n1){
-        arr[k] = L[i];
-        i++;
-        k++;
-    }
-    while(j < n2){
-        arr[k] = R[j];
-        j++;
-        k++;
+    if(v1->key.lo != v2->key.lo){
+        return v1->key.lo < v2->key.lo ? -1 : 1;
     }
+    return 0;
 }
 
 /**
-  * @brief Performs merge sort on an array of vaccines.
+  * @brief Finds the position where a batch belongs in a sorted part of
+  * the order.
   *
-  * @param arr Array of vaccines.
-  * @param l Left index.
-  * @param r Right index.
+  * Binary search over sys->order from lo to hi, which must be ordered by
+  * compareBatches(); removed batches keep their place until compaction.
+  *
+  * @param sys Pointer to the system.
+  * @param lo First position searched.
+  * @param hi Position after the last one searched.
+  * @param vacc Batch to locate.
+  * @return Index of the first batch that does not come before vacc.
   */
-void mergeSort(Vaccine arr[], int l, int r){
-    if(l < r){
-        int m = l + (r - l) / 2;
-        mergeSort(arr, l, m);
-        mergeSort(arr, m + 1, r);
-        merge(arr, l, m, r);
+int findBatchPos(Sys *sys, int lo, int hi, const Vaccine *vacc){
+    while(lo < hi){
+        int mid = lo + (hi - lo) / 2;
+        if(compareBatches(&sys->store[sys->order[mid]], vacc) < 0){
+            lo = mid + 1;
+        }else{
+            hi = mid;
+        }
     }
+    return lo;
+}
+
+/**
+  * @brief Prints one batch as a line of the 'l' listing.
+  *
+  * @param sys Pointer to the system.
+  * @param v Pointer to the batch.
+  */
+void printBatch(Sys *sys, Vaccine *v){
+    outStr(&sys->out, v->name);
+    outChar(&sys->out, ' ');
+    outBatch(&sys->out, v->key);
+    outChar(&sys->out, ' ');
+    outDate(&sys->out, v->expir);
+    outChar(&sys->out, ' ');
+    outInt(&sys->out, v->doses);
+    outChar(&sys->out, ' ');
+    outInt(&sys->out, v->applys);
+    outChar(&sys->out, '\n');
 }
 
 /**
@@ -173,85 +320,116 @@ void mergeSort(Vaccine arr[], int l, int r){
   * @param in Input string.
   */
 void listVaccines(Sys *sys, char *in){
-    int i, j, numVac = 0;
-    char *nameV;
-    char namesVaccs[MAXBATCHES][MAXNAMEVACC];
- 
-    if(sys->cntV > 0){
-        mergeSort(sys->arr, 0, sys->cntV - 1);
-    }
- 
-    in[strcspn(in, "\n")] = '\0';
- 
-    nameV = strtok(in, " ");
-    while((nameV = strtok(NULL, " ")) != NULL){
-        strcpy(namesVaccs[numVac], nameV);
-        numVac++;
-    }
+    int i;
+    Token name;
+    char *cur = in + 1;
  
-    if(numVac == 0){
-        for(i = 0; i < sys->cntV; i++){
-            printf("%s %s %.2d-%.2d-%d %d %d\n", sys->arr[i].name,
-                sys->arr[i].batch, sys->arr[i].expir.day,
-                sys->arr[i].expir.month, sys->arr[i].expir.year,
-                sys->arr[i].doses, sys->arr[i].applys);
+    if(!nextToken(&cur, &name)){
+        mergeOrder(sys);
+        if(startScan(sys, 'l', 0, 0)){
+            return;
+        }
+        for(i = 0; i < sys->cntOrder; i++){
+            if(!sys->store[sys->order[i]].dead){
+                printBatch(sys, &sys->store[sys->order[i]]);
+            }
         }
         return;
     }
  
-    for(i = 0; i < numVac; i++){
-        int vaccFound = 0;
-        for(j = 0; j < sys->cntV; j++){
-            if(strcmp(sys->arr[j].name, namesVaccs[i]) == 0){
-                printf("%s %s %.2d-%.2d-%d %d %d\n", sys->arr[j].name,
-                    sys->arr[j].batch, sys->arr[j].expir.day,
-                    sys->arr[j].expir.month, sys->arr[j].expir.year,
-                    sys->arr[j].doses, sys->arr[j].applys);
-                vaccFound = 1;
+    do{
+        int id = findName(&sys->names, name.s);
+        NameEntry *e = id == -1 ? NULL : &sys->names.list[id];
+        if(e != NULL && e->cnt > 0){
+            mergeNameBatches(sys, e);
+            for(i = 0; i < e->cnt; i++){
+                printBatch(sys, &sys->store[e->ids[i]]);
             }
+        }else{
+            outStr(&sys->out, name.s);
+            outStr(&sys->out, ": ");
+            outError(&sys->out, sys->state, PTENOVACCINE, ENGENOVACCINE);
         }
-        if(!vaccFound){
-            printf("%s: ", namesVaccs[i]);
-            puts(sys->state == PT ? PTENOVACCINE : ENGENOVACCINE);
-        }
-    }
+    }while(nextToken(&cur, &name));
 }
 
 /**
   * @brief Deletes a vaccine batch.
   *
   * If no inoculations have been made from the batch, the batch is removed.
-  * Otherwise, its available doses become zero.
+  * Otherwise, its available doses become zero. A removed batch is only
+  * flagged in the listing order, which is compacted once enough of it is
+  * dead, instead of shifting the order on every removal.
   *
   * @param sys Pointer to the system.
   * @param in Input string containing the batch identifier.
   */
 void deleteVaccines(Sys *sys, char *in){
-    char *batchToken = strtok(in, " ");
-    batchToken = strtok(NULL, " ");
+    Token batch = {"", 0};
+    BatchKey key;
+    char *cur = in + 1;
+    nextToken(&cur, &batch);
      
-    int index = -1;
-    for(int i = 0; i < sys->cntV; i++){
-        if(strcmp(sys->arr[i].batch, batchToken) == 0){
-            index = i;
-            break;
-        }
-    }
+    int id = parseBatch(&batch, &key) ? findBatch(sys, &key) : -1;
      
-    if(index == -1){
-        printf("%s: ", batchToken);
-        puts(sys->state == PT ? PTENOBATCH : ENGENOBATCH);
+    if(id == -1){
+        outStr(&sys->out, batch.s);
+        outStr(&sys->out, ": ");
+        outError(&sys->out, sys->state, PTENOBATCH, ENGENOBATCH);
         return;
     }
      
-    if(sys->arr[index].applys == 0){
-        for(int i = index; i < sys->cntV - 1; i++){
-            sys->arr[i] = sys->arr[i + 1];
-        }
+    Vaccine *v = &sys->store[id];
+    outInt(&sys->out, v->applys);
+    outChar(&sys->out, '\n');
+     
+    NameEntry *e = &sys->names.list[v->nameId];
+    /* Doses of an expired batch were already lost when it expired */
+    if(compareDates(v->expir, sys->tcurr) >= 0){
+        countDoses(sys, v->nameId, -v->doses);
+    }
+    if(v->applys == 0){
+        removeNameBatch(sys, e, id);
+        removeBatchId(sys, id);
+        v->dead = 1;
         sys->cntV--;
+        sys->cntDead++;
+        if(worthCompacting(sys, sys->cntDead, sys->cntOrder)){
+            compactBatches(sys);
+        }
     }else{
-        sys->arr[index].doses = 0;
+        v->doses = 0;
+        advanceStock(sys, e);
     }
-     
-    printf("%d\n", sys->arr[index].applys);
-}
\ No newline at end of file
+}
+
+/**
+  * @brief Retires the batches that expired before the current date.
+  *
+  * Since new batches never expire before the current date, the expired
+  * batches are always a prefix of sys->order; only the batches
+  * that expired since the last call are visited. Their remaining doses
+  * are counted as wasted and dispensing skips them from now on. New
+  * batches not merged into the order yet expire after every batch
+  * already retired, so the order is only merged if one of them expired.
+  *
+  * @param sys Pointer to the system.
+  */
+void retireExpired(Sys *sys){
+    if(sys->cntSorted < sys->cntOrder &&
+        compareDates(sys->store[sys->order[sys->cntSorted]].expir,
+            sys->tcurr) < 0){
+        mergeOrder(sys);
+    }
+    while(sys->cntExpired < sys->cntOrder &&
+        compareDates(sys->store[sys->order[sys->cntExpired]].expir,
+            sys->tcurr) < 0){
+        Vaccine *v = &sys->store[sys->order[sys->cntExpired]];
+        sys->cntExpired++;
+        if(!v->dead){
+            sys->wastedDoses += v->doses;
+            countDoses(sys, v->nameId, -v->doses);
+            advanceStock(sys, &sys->names.list[v->nameId]);
+        }
+    }
+}
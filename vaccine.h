@@ -5,9 +5,13 @@
 
 /* Function prototypes related to vaccine batches */
 void createBatch(Sys *sys, char *in);
-void merge(Vaccine arr[], int l, int m, int r);
-void mergeSort(Vaccine arr[], int l, int r);
+int compareBatches(const Vaccine *v1, const Vaccine *v2);
+int findBatchPos(Sys *sys, int lo, int hi, const Vaccine *vacc);
+void mergeOrder(Sys *sys);
+void printBatch(Sys *sys, Vaccine *v);
 void listVaccines(Sys *sys, char *in);
 void deleteVaccines(Sys *sys, char *in);
+void retireExpired(Sys *sys);
+int worthCompacting(Sys *sys, int dead, int total);
 
 #endif /* VACCINE_H */
\ No newline at end of file